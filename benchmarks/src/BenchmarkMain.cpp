@@ -0,0 +1,20 @@
+#include <benchmark/benchmark.h>
+#include <QApplication>
+
+
+int main(int argc, char** argv) {
+    // The tray icons are rendered without showing them, so no display is needed
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    // The resources are in the static birdtray library, make sure they are linked
+    Q_INIT_RESOURCE(resources);
+    
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
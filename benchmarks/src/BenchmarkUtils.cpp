@@ -0,0 +1,41 @@
+#include "BenchmarkUtils.h"
+#include <string>
+
+#if defined(Q_OS_WIN)
+#  include <windows.h>
+#  include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#  include <sys/resource.h>
+#endif
+
+qint64 peakResidentSetSize() {
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<qint64>(counters.PeakWorkingSetSize);
+    }
+    return 0;
+#elif defined(Q_OS_UNIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#  ifdef Q_OS_MACOS
+    return static_cast<qint64>(usage.ru_maxrss);
+#  else
+    return static_cast<qint64>(usage.ru_maxrss) * 1024;
+#  endif /* Q_OS_MACOS */
+#else
+    return 0;
+#endif
+}
+
+void reportMemoryCounters(benchmark::State &state, quint64 allocations,
+                          const char* unit, int unitsPerIteration) {
+    if (AllocationCounter::isSupported() && unitsPerIteration > 0) {
+        state.counters[std::string("allocs_per_") + unit] = benchmark::Counter(
+                static_cast<double>(allocations) / unitsPerIteration,
+                benchmark::Counter::kAvgIterations);
+    }
+    state.counters["peak_rss_MB"] = static_cast<double>(peakResidentSetSize()) / (1024 * 1024);
+}
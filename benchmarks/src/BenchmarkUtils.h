@@ -0,0 +1,27 @@
+#ifndef BIRDTRAY_BENCHMARK_UTILS_H
+#define BIRDTRAY_BENCHMARK_UTILS_H
+
+
+#include <benchmark/benchmark.h>
+#include <QtCore/QtGlobal>
+#include "AllocationCounter.h"
+
+/**
+ * @return The peak resident set size of the process in bytes, or 0 if it is unknown.
+ */
+qint64 peakResidentSetSize();
+
+/**
+ * Report the memory usage of a finished benchmark as counters, the number of heap allocations
+ * per unit of work and the peak resident set size of the process so far.
+ *
+ * @param state The state of the benchmark.
+ * @param allocations The number of heap allocations during all iterations.
+ * @param unit The name of the unit of work, e.g. "parse".
+ * @param unitsPerIteration The number of units of work in each iteration.
+ */
+void reportMemoryCounters(benchmark::State &state, quint64 allocations,
+                          const char* unit, int unitsPerIteration = 1);
+
+
+#endif /* BIRDTRAY_BENCHMARK_UTILS_H */
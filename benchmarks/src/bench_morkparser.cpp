@@ -0,0 +1,302 @@
+#include <benchmark/benchmark.h>
+#include <morkparser.h>
+#include <morkscantask.h>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMap>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+#include "BenchmarkUtils.h"
+#include "MorkGenerator.h"
+#include "TestResources.h"
+
+
+/**
+ * Parse the whole mork file with the generic parser.
+ */
+static void BM_MorkParserOpen(benchmark::State &state, const QString &path) {
+    const qint64 size = QFileInfo(path).size();
+    const quint64 allocations = AllocationCounter::allocations();
+    for (auto _ : state) {
+        MorkParser parser;
+        if (!parser.open(path)) {
+            state.SkipWithError("Unable to open the mork file");
+            break;
+        }
+        benchmark::DoNotOptimize(parser);
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+    reportMemoryCounters(state, AllocationCounter::allocations() - allocations, "parse");
+}
+
+/**
+ * Parse the whole mork file and read the number of unread emails from it.
+ */
+static void BM_MailMorkParserUnreadCount(benchmark::State &state, const QString &path) {
+    const qint64 size = QFileInfo(path).size();
+    const quint64 allocations = AllocationCounter::allocations();
+    for (auto _ : state) {
+        MailMorkParser parser;
+        if (!parser.open(path)) {
+            state.SkipWithError("Unable to open the mork file");
+            break;
+        }
+        benchmark::DoNotOptimize(parser.getNumUnreadMessages());
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+    reportMemoryCounters(state, AllocationCounter::allocations() - allocations, "parse");
+}
+
+/**
+ * Parse the whole mork file and read the number of unread emails from it,
+ * with one parser which is reused for every parse.
+ */
+static void BM_MailMorkParserReusedUnreadCount(benchmark::State &state, const QString &path) {
+    const qint64 size = QFileInfo(path).size();
+    MailMorkParser parser;
+    const quint64 allocations = AllocationCounter::allocations();
+    for (auto _ : state) {
+        if (!parser.open(path)) {
+            state.SkipWithError("Unable to open the mork file");
+            break;
+        }
+        benchmark::DoNotOptimize(parser.getNumUnreadMessages());
+        parser.reset();
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+    reportMemoryCounters(state, AllocationCounter::allocations() - allocations, "parse");
+}
+
+/**
+ * Read the number of unread emails with the scanner of the unread monitor,
+ * for a file which it didn't parse before.
+ */
+static void BM_MorkUnreadScannerUpdate(benchmark::State &state, const QString &path) {
+    const qint64 size = QFileInfo(path).size();
+    const quint64 allocations = AllocationCounter::allocations();
+    for (auto _ : state) {
+        MorkUnreadScanner scanner;
+        if (!scanner.update(path)) {
+            state.SkipWithError("Unable to parse the mork file");
+            break;
+        }
+        benchmark::DoNotOptimize(scanner.getNumUnreadMessages());
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+    reportMemoryCounters(state, AllocationCounter::allocations() - allocations, "parse");
+}
+
+/**
+ * Read the number of unread emails from a generated mork file with the size of a large folder.
+ * The argument is the number of messages, a transaction group is appended for every
+ * hundred of them, like an index which was updated for a long time.
+ */
+static void BM_MorkUnreadScannerUpdateGenerated(benchmark::State &state) {
+    QTemporaryDir directory;
+    MorkGenerator::Options options;
+    options.messages = static_cast<int>(state.range(0));
+    options.columns = 12;
+    options.groups = options.messages / 100;
+    options.escapeDensity = 0.02;
+    options.rewriteRatio = 0.1;
+    options.unreadMessages = 42;
+    const QString path = directory.filePath("Generated.msf");
+    if (!directory.isValid() || !MorkGenerator(options).write(path)) {
+        state.SkipWithError("Unable to write the generated mork file");
+        return;
+    }
+    BM_MorkUnreadScannerUpdate(state, path);
+}
+BENCHMARK(BM_MorkUnreadScannerUpdateGenerated)->Arg(20000)->Arg(200000)
+        ->Unit(benchmark::kMillisecond);
+
+/**
+ * The path of a generated mork file of more than 100 MB with escaped values, like the index of
+ * a very large folder. It is written once for all benchmarks which use it.
+ *
+ * @return The path of the file, or an empty string if it could not be written.
+ */
+static const QString &largeGeneratedMorkFile() {
+    static QTemporaryDir directory;
+    static QString path;
+    if (path.isEmpty() && directory.isValid()) {
+        MorkGenerator::Options options;
+        options.messages = 400000;
+        options.columns = 12;
+        options.groups = options.messages / 100;
+        options.escapeDensity = 0.02;
+        options.rewriteRatio = 0.1;
+        options.unreadMessages = 42;
+        const QString filePath = directory.filePath("Large.msf");
+        if (MorkGenerator(options).write(filePath)) {
+            path = filePath;
+        }
+    }
+    return path;
+}
+
+/**
+ * Read the number of unread emails from the large generated mork file, once with the full
+ * mail parser and once with the scanner of the unread monitor. The argument is the
+ * MorkStructuralIndex::Implementation which finds the structural chars.
+ */
+static void BM_MorkStructuralIndex(benchmark::State &state, bool fullParser) {
+    const auto implementation = static_cast<MorkStructuralIndex::Implementation>(state.range(0));
+    const QString &path = largeGeneratedMorkFile();
+    if (path.isEmpty()) {
+        state.SkipWithError("Unable to write the generated mork file");
+        return;
+    }
+    state.SetLabel(implementation == MorkStructuralIndex::Implementation::Scalar ? "scalar" : "best");
+    const qint64 size = QFileInfo(path).size();
+    for (auto _ : state) {
+        if (fullParser) {
+            MailMorkParser parser;
+            parser.setStructuralImplementation(implementation);
+            if (!parser.open(path)) {
+                state.SkipWithError("Unable to open the mork file");
+                break;
+            }
+            benchmark::DoNotOptimize(parser.getNumUnreadMessages());
+        } else {
+            MorkUnreadScanner scanner;
+            scanner.setStructuralImplementation(implementation);
+            if (!scanner.update(path)) {
+                state.SkipWithError("Unable to parse the mork file");
+                break;
+            }
+            benchmark::DoNotOptimize(scanner.getNumUnreadMessages());
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK_CAPTURE(BM_MorkStructuralIndex, MailMorkParser, true)
+        ->Arg(static_cast<int>(MorkStructuralIndex::Implementation::Scalar))
+        ->Arg(static_cast<int>(MorkStructuralIndex::Implementation::Best))
+        ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_MorkStructuralIndex, MorkUnreadScanner, false)
+        ->Arg(static_cast<int>(MorkStructuralIndex::Implementation::Scalar))
+        ->Arg(static_cast<int>(MorkStructuralIndex::Implementation::Best))
+        ->Unit(benchmark::kMillisecond);
+
+/**
+ * Parse a generated mork file with many transaction groups, ten messages are added in each
+ * of them. The argument is the number of groups, the parse time should grow linearly with it.
+ */
+static void BM_MailMorkParserGroups(benchmark::State &state) {
+    QTemporaryDir directory;
+    MorkGenerator::Options options;
+    options.groups = static_cast<int>(state.range(0));
+    options.messages = options.groups * 10;
+    options.unreadMessages = 3;
+    const QString path = directory.filePath("Generated.msf");
+    if (!directory.isValid() || !MorkGenerator(options).write(path)) {
+        state.SkipWithError("Unable to write the generated mork file");
+        return;
+    }
+    BM_MailMorkParserUnreadCount(state, path);
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_MailMorkParserGroups)->Arg(250)->Arg(500)->Arg(1000)->Arg(2000)
+        ->Unit(benchmark::kMillisecond)->Complexity(benchmark::oN);
+
+/**
+ * Parse a generated mork file whose message rows have many cells, like the index
+ * of a folder with many custom columns. The argument is the number of cells of each row.
+ */
+static void BM_MorkParserOpenWideRows(benchmark::State &state) {
+    QTemporaryDir directory;
+    MorkGenerator::Options options;
+    options.messages = 1000;
+    options.columns = static_cast<int>(state.range(0));
+    options.unreadMessages = 42;
+    const QString path = directory.filePath("Generated.msf");
+    if (!directory.isValid() || !MorkGenerator(options).write(path)) {
+        state.SkipWithError("Unable to write the generated mork file");
+        return;
+    }
+    BM_MorkParserOpen(state, path);
+}
+BENCHMARK(BM_MorkParserOpenWideRows)->Arg(10)->Arg(100)->Arg(500)->Unit(benchmark::kMillisecond);
+
+/**
+ * Read the total number of unread emails of N watched mork files, like the unread monitor
+ * does when all files need to be read: the fingerprint of each file is taken, each file
+ * is parsed by its own scanner with the scan tasks of the monitor, and the unread counts
+ * are added up.
+ */
+static void BM_UnreadCountMork(benchmark::State &state) {
+    const QStringList fixtures = TestResources::getAbsoluteResourcePaths("*.msf");
+    const int fileCount = static_cast<int>(state.range(0));
+    QTemporaryDir directory;
+    if (!directory.isValid()) {
+        state.SkipWithError("Unable to create the directory for the mork files");
+        return;
+    }
+    // The monitor watches distinct files, so copy the fixtures to as many paths as needed
+    QStringList paths;
+    qint64 size = 0;
+    for (int i = 0; i < fileCount; i++) {
+        paths.append(directory.filePath(QString("Folder%1.msf").arg(i)));
+        if (!QFile::copy(fixtures[i % fixtures.size()], paths.last())) {
+            state.SkipWithError("Unable to copy the mork file");
+            return;
+        }
+        size += QFileInfo(paths.last()).size();
+    }
+
+    QThreadPool scanPool;
+    const quint64 allocations = AllocationCounter::allocations();
+    for (auto _ : state) {
+        QVector<MorkUnreadScanner*> scanners;
+        QMap<QString, MorkFileFingerprint> fingerprints;
+        QList<MorkScanTask*> tasks;
+        for (const QString &path : paths) {
+            scanners.append(new MorkUnreadScanner());
+            const MorkFileFingerprint fingerprint = MorkFileFingerprint::of(path);
+            if (fingerprints.contains(path) && fingerprints[path] == fingerprint) {
+                continue;
+            }
+            fingerprints[path] = fingerprint;
+            tasks.append(new MorkScanTask(path, scanners.last(), QByteArray()));
+        }
+        MorkScanTask::runAll(scanPool, tasks);
+
+        unsigned int total = 0;
+        for (MorkScanTask* task : tasks) {
+            if (!task->mSuccess) {
+                state.SkipWithError("Unable to parse the mork file");
+                break;
+            }
+            total += task->mParser->getNumUnreadMessages();
+        }
+        benchmark::DoNotOptimize(total);
+        qDeleteAll(tasks);
+        qDeleteAll(scanners);
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+    reportMemoryCounters(state, AllocationCounter::allocations() - allocations, "parse", fileCount);
+}
+BENCHMARK(BM_UnreadCountMork)->RangeMultiplier(4)->Range(1, 64)->UseRealTime();
+
+/**
+ * Register the benchmarks which run once for each mork test resource.
+ *
+ * @return true
+ */
+static bool registerMorkFileBenchmarks() {
+    for (const QString &path : TestResources::getAbsoluteResourcePaths("*.msf")) {
+        const std::string name = QFileInfo(path).fileName().toStdString();
+        benchmark::RegisterBenchmark(("BM_MorkParserOpen/" + name).c_str(),
+                BM_MorkParserOpen, path);
+        benchmark::RegisterBenchmark(("BM_MailMorkParserUnreadCount/" + name).c_str(),
+                BM_MailMorkParserUnreadCount, path);
+        benchmark::RegisterBenchmark(("BM_MailMorkParserReusedUnreadCount/" + name).c_str(),
+                BM_MailMorkParserReusedUnreadCount, path);
+        benchmark::RegisterBenchmark(("BM_MorkUnreadScannerUpdate/" + name).c_str(),
+                BM_MorkUnreadScannerUpdate, path);
+    }
+    return true;
+}
+static const bool morkFileBenchmarksRegistered = registerMorkFileBenchmarks();
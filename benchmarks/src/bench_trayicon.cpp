@@ -0,0 +1,63 @@
+#include <benchmark/benchmark.h>
+#include <trayiconrenderer.h>
+#include <settings.h>
+#include "BenchmarkUtils.h"
+
+
+/**
+ * @return The default settings, which are used to render the tray icons.
+ *         They are never deleted, as their pixmaps must not outlive the application.
+ */
+static Settings* defaultSettings() {
+    static Settings* settings = new Settings();
+    return settings;
+}
+
+/**
+ * @param unread The shown unread count.
+ * @param opacity The opacity of the icon in percent.
+ * @return The state of the tray icon while it is blinking.
+ */
+static TrayIconState blinkingState(unsigned int unread, int opacity) {
+    TrayIconState state;
+    state.unread = unread;
+    state.color = QColor("#0000FF").rgba();
+    state.iconOpacity = opacity;
+    state.textOpacity = 100 - opacity;
+    return state;
+}
+
+/**
+ * Render a new icon for each update, like TrayIcon::updateIcon did without the icon cache.
+ * The argument is the shown unread count.
+ */
+static void BM_TrayIconRender(benchmark::State &state) {
+    TrayIconRenderer renderer(defaultSettings());
+    const unsigned int unread = static_cast<unsigned int>(state.range(0));
+    int opacity = 0;
+    const quint64 allocations = AllocationCounter::allocations();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(renderer.render(blinkingState(unread, opacity)));
+        opacity = (opacity + 5) % 100;
+    }
+    reportMemoryCounters(state, AllocationCounter::allocations() - allocations, "icon");
+}
+BENCHMARK(BM_TrayIconRender)->Arg(0)->Arg(7)->Arg(1234);
+
+/**
+ * The icon updates of TrayIcon::updateIcon during a blinking cycle, which are all served
+ * from the icon cache once the first cycle was rendered.
+ * The argument is the shown unread count.
+ */
+static void BM_TrayIconUpdateIconBlinking(benchmark::State &state) {
+    TrayIconRenderer renderer(defaultSettings());
+    const unsigned int unread = static_cast<unsigned int>(state.range(0));
+    int opacity = 0;
+    const quint64 allocations = AllocationCounter::allocations();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(renderer.icon(blinkingState(unread, opacity)));
+        opacity = (opacity + 5) % 100;
+    }
+    reportMemoryCounters(state, AllocationCounter::allocations() - allocations, "icon");
+}
+BENCHMARK(BM_TrayIconUpdateIconBlinking)->Arg(7)->Arg(1234);
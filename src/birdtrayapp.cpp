@@ -58,9 +58,17 @@ BirdtrayApp::BirdtrayApp(int &argc, char** argv) : QApplication(argc, argv)
         return;
     }
     
-    Log::initialize(commandLineParser.value("log"));
+    Log::initialize(commandLineParser.value("log"),
+            commandLineParser.value("log-overflow") == "block"
+                    ? Log::OverflowPolicy::Block : Log::OverflowPolicy::Drop);
+    const QString logLevel = commandLineParser.value("log-level");
+    if (logLevel == "info") {
+        Log::setMinimumLevel(Log::Level::Info);
+    } else if (logLevel == "warning") {
+        Log::setMinimumLevel(Log::Level::Warning);
+    }
 
-    Log::debug( "Birdtray version %d.%d.%d started", VERSION_MAJOR, VERSION_MINOR, VERSION_PATCH );
+    LOG_INFO( "Birdtray version %d.%d.%d started", VERSION_MAJOR, VERSION_MINOR, VERSION_PATCH );
 
     ensureSystemTrayAvailable();
     // Load settings
@@ -72,7 +80,7 @@ BirdtrayApp::BirdtrayApp(int &argc, char** argv) : QApplication(argc, argv)
     }
 
     if (!translationLoadedSuccessfully) {
-        Log::debug("Failed to load translation for %s", qPrintable(QLocale::system().name()));
+        LOG_WARNING("Failed to load translation for %s", qPrintable(QLocale::system().name()));
     }
     autoUpdater = new AutoUpdater();
     trayIcon = new TrayIcon(commandLineParser.isSet("settings"));
@@ -87,6 +95,9 @@ BirdtrayApp::~BirdtrayApp() {
     delete trayIcon;
     delete autoUpdater;
     delete settings;
+
+    // Write the last log lines, including the ones of the shutdown
+    Log::shutdown();
 }
 
 BirdtrayApp* BirdtrayApp::get() {
@@ -108,7 +119,7 @@ TrayIcon* BirdtrayApp::getTrayIcon() const {
 bool BirdtrayApp::event(QEvent* event) {
     if (event->type() == QEvent::LocaleChange) {
         if (!loadTranslations()) {
-            Log::debug("Failed to load translation for %s", qPrintable(QLocale::system().name()));
+            LOG_WARNING("Failed to load translation for %s", qPrintable(QLocale::system().name()));
         }
         return true;
     }
@@ -170,7 +181,11 @@ void BirdtrayApp::parseCmdArguments() {
             {{"s", SHOW_BETTERBIRD_COMMAND}, tr("Show the Betterbird window.")},
             {{"H", HIDE_BETTERBIRD_COMMAND}, tr("Hide the Betterbird window.")},
             {{"r", "reset-settings"}, tr("Reset the settings to the defaults.")},
-            {{"l", "log"}, tr("Write log to a file."), tr("file")}
+            {{"l", "log"}, tr("Write log to a file."), tr("file")},
+            {"log-overflow", tr("What to do with log lines when the log buffer is full: "
+                                "drop (default) or block."), tr("policy")},
+            {"log-level", tr("The lowest level of the log lines which are written: "
+                             "debug (default), info or warning."), tr("level")}
     });
     commandLineParser.process(*this);
 }
@@ -93,6 +93,7 @@ DialogSettings::DialogSettings( QWidget *parent)
     else
         boxForceReread->setChecked( false );
     spinWatchFileTimerMilliseconds->setValue( static_cast<int>(settings->mWatchFileTimeout) );
+    spinUnreadScanThreads->setValue( static_cast<int>(settings->mUnreadScanThreads) );
 
     // Form the proper command-line (with escaped arguments if they contain spaces
     QString bbcmdline;
@@ -196,6 +197,7 @@ void DialogSettings::accept()
         settings->mIndexFilesRereadIntervalSec = 0;
     
     settings->mWatchFileTimeout = spinWatchFileTimerMilliseconds->value();
+    settings->mUnreadScanThreads = spinUnreadScanThreads->value();
 
     mModelNewEmails->applySettings();
     mAccountModel->applySettings();
@@ -0,0 +1,36 @@
+#include "filechangestate.h"
+
+const qint64 FileChangeState::MAX_WINDOW_FACTOR;
+const qint64 FileChangeState::MAX_LATENCY_FACTOR;
+
+qint64 FileChangeState::nextWindow( qint64 window, qint64 gap, qint64 baseWindow )
+{
+    // The file changes in bursts, so wait longer for it to settle
+    if ( gap < window )
+        return qMin( window * 2, baseWindow * MAX_WINDOW_FACTOR );
+
+    // The file is quiet, so it can be read sooner
+    if ( gap > window * 4 )
+        return qMax( window / 2, baseWindow );
+
+    return window;
+}
+
+void FileChangeState::recordChange( qint64 now, qint64 baseWindow )
+{
+    if ( lastChange < 0 )
+        window = baseWindow;
+    else
+        window = nextWindow( window, now - lastChange, baseWindow );
+
+    lastChange = now;
+
+    if ( pendingSince < 0 )
+        pendingSince = now;
+}
+
+qint64 FileChangeState::deadline( qint64 baseWindow ) const
+{
+    // Read the file once it settled, but don't let a file which keeps changing wait forever
+    return qMin( lastChange + window, pendingSince + baseWindow * MAX_LATENCY_FACTOR );
+}
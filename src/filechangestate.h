@@ -0,0 +1,53 @@
+#ifndef FILECHANGESTATE_H
+#define FILECHANGESTATE_H
+
+#include <QtGlobal>
+
+// The debounce state of a watched file. All times are in milliseconds of the same clock,
+// the base window is the watch file timeout from the settings.
+struct FileChangeState
+{
+    // The debounce window of a file which changes in bursts grows up to this multiple of the base window
+    static const qint64 MAX_WINDOW_FACTOR = 8;
+
+    // A changed file is read after this multiple of the base window at the latest,
+    // even if it keeps changing
+    static const qint64 MAX_LATENCY_FACTOR = 16;
+
+    // The debounce window, which grows while the file changes in bursts
+    qint64      window = 0;
+
+    // The time of the last change notification, or -1 if there was none yet
+    qint64      lastChange = -1;
+
+    // The time of the first change which wasn't handled yet, or -1 if there is none
+    qint64      pendingSince = -1;
+
+    /**
+     * Calculate the debounce window after a change notification. The window doubles while
+     * the changes come within the window, up to MAX_WINDOW_FACTOR times the base window,
+     * and halves again, down to the base window, after a gap of more than four windows.
+     *
+     * @param window The current debounce window.
+     * @param gap The time since the previous change notification.
+     * @param baseWindow The base debounce window.
+     * @return The new debounce window.
+     */
+    static qint64 nextWindow( qint64 window, qint64 gap, qint64 baseWindow );
+
+    /**
+     * Record a change notification of the file.
+     *
+     * @param now The time of the notification.
+     * @param baseWindow The base debounce window.
+     */
+    void    recordChange( qint64 now, qint64 baseWindow );
+
+    /**
+     * @param baseWindow The base debounce window.
+     * @return The time at which the pending change of the file needs to be handled.
+     */
+    qint64  deadline( qint64 baseWindow ) const;
+};
+
+#endif // FILECHANGESTATE_H
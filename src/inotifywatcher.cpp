@@ -0,0 +1,200 @@
+#include <QSocketNotifier>
+#include <QFileInfo>
+#include <QFile>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include "inotifywatcher.h"
+#include "log.h"
+
+// Betterbird may keep the file open while appending to it, so besides the completed writes
+// and renames over the file, the single writes are reported as well. The change notifications
+// are debounced by the UnreadMonitor anyway.
+static const uint32_t FILE_EVENTS = IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+
+// The directory itself was removed or renamed
+static const uint32_t DIRECTORY_EVENTS = IN_DELETE_SELF | IN_MOVE_SELF;
+
+InotifyWatcher::InotifyWatcher( QObject * parent )
+    : QObject( parent ), mNotifier( nullptr )
+{
+    mInotifyFd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+
+    if ( mInotifyFd == -1 )
+    {
+        LOG_WARNING( "Unable to initialize inotify: %s", strerror( errno ) );
+        return;
+    }
+
+    mNotifier = new QSocketNotifier( mInotifyFd, QSocketNotifier::Read, this );
+    connect( mNotifier, SIGNAL(activated(int)), this, SLOT(readEvents()) );
+}
+
+InotifyWatcher::~InotifyWatcher()
+{
+    if ( mInotifyFd != -1 )
+        close( mInotifyFd );
+}
+
+bool InotifyWatcher::addPath( const QString &path )
+{
+    if ( mInotifyFd == -1 )
+        return false;
+
+    QFileInfo info( path );
+    int wd = watchDirectory( info.absolutePath() );
+
+    if ( wd == -1 )
+        return false;
+
+    mWatchedNames[ wd ][ info.fileName() ] = path;
+    return true;
+}
+
+bool InotifyWatcher::removePath( const QString &path )
+{
+    for ( QHash< int, QHash< QString, QString > >::iterator it = mWatchedNames.begin(); it != mWatchedNames.end(); ++it )
+    {
+        const QString name = it.value().key( path );
+
+        if ( name.isEmpty() )
+            continue;
+
+        it.value().remove( name );
+
+        // Nothing else is watched in this directory
+        if ( it.value().isEmpty() )
+        {
+            inotify_rm_watch( mInotifyFd, it.key() );
+            mDirectories.remove( it.key() );
+            mWatchedNames.erase( it );
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+QStringList InotifyWatcher::files() const
+{
+    QStringList paths;
+
+    for ( const QHash< QString, QString > &names : mWatchedNames )
+        paths.append( names.values() );
+
+    return paths;
+}
+
+int InotifyWatcher::watchDirectory( const QString &directory )
+{
+    // Watching a directory again returns the same watch descriptor
+    int wd = inotify_add_watch( mInotifyFd, QFile::encodeName( directory ).constData(), FILE_EVENTS | DIRECTORY_EVENTS );
+
+    if ( wd == -1 )
+    {
+        LOG_WARNING( "Unable to watch directory %s: %s", qPrintable( directory ), strerror( errno ) );
+        return -1;
+    }
+
+    mDirectories[ wd ] = directory;
+    return wd;
+}
+
+void InotifyWatcher::readEvents()
+{
+    alignas( struct inotify_event ) char buffer[ 4096 ];
+    QStringList changedPaths;
+    QList< int > lostWatches;
+    bool overflowed = false;
+
+    // Collect all pending events, so each file is reported once per batch
+    while ( true )
+    {
+        ssize_t length = read( mInotifyFd, buffer, sizeof( buffer ) );
+
+        if ( length <= 0 )
+        {
+            if ( length == -1 && errno == EINTR )
+                continue;
+
+            break;
+        }
+
+        for ( char * ptr = buffer; ptr < buffer + length; )
+        {
+            const struct inotify_event * event = reinterpret_cast<const struct inotify_event *>( ptr );
+            ptr += sizeof( struct inotify_event ) + event->len;
+
+            // The kernel dropped events, any watched file may have changed
+            if ( event->mask & IN_Q_OVERFLOW )
+            {
+                overflowed = true;
+                continue;
+            }
+
+            if ( event->mask & ( DIRECTORY_EVENTS | IN_IGNORED ) )
+            {
+                if ( !lostWatches.contains( event->wd ) )
+                    lostWatches.append( event->wd );
+
+                continue;
+            }
+
+            if ( event->len == 0 || !( event->mask & FILE_EVENTS ) )
+                continue;
+
+            QHash< int, QHash< QString, QString > >::const_iterator names = mWatchedNames.constFind( event->wd );
+
+            if ( names == mWatchedNames.cend() )
+                continue;
+
+            const QString path = names.value().value( QFile::decodeName( event->name ) );
+
+            if ( !path.isEmpty() && !changedPaths.contains( path ) )
+                changedPaths.append( path );
+        }
+    }
+
+    if ( overflowed )
+    {
+        LOG_WARNING( "The inotify event queue overflowed, reporting all watched files as changed" );
+        changedPaths = files();
+    }
+
+    // Re-arm the watches of the directories which were replaced, and report all their files as changed
+    for ( int wd : lostWatches )
+    {
+        if ( !mDirectories.contains( wd ) )
+            continue;
+
+        const QString directory = mDirectories.take( wd );
+        const QHash< QString, QString > names = mWatchedNames.take( wd );
+        inotify_rm_watch( mInotifyFd, wd );
+
+        for ( const QString &path : names )
+        {
+            if ( !changedPaths.contains( path ) )
+                changedPaths.append( path );
+        }
+
+        const int newWd = watchDirectory( directory );
+
+        if ( newWd == -1 )
+        {
+            LOG_WARNING( "Lost the watch of directory %s", qPrintable( directory ) );
+            continue;
+        }
+
+        QHash< QString, QString > &watchedNames = mWatchedNames[ newWd ];
+
+        for ( QHash< QString, QString >::const_iterator it = names.cbegin(); it != names.cend(); ++it )
+            watchedNames.insert( it.key(), it.value() );
+    }
+
+    for ( const QString &path : changedPaths )
+        emit fileChanged( path );
+}
@@ -0,0 +1,72 @@
+#ifndef INOTIFYWATCHER_H
+#define INOTIFYWATCHER_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+class QSocketNotifier;
+
+// Watches files for changes using inotify. Instead of the files themselves, their directories
+// are watched and the events are matched against the file names. Unlike QFileSystemWatcher,
+// this keeps watching a file after it was atomically replaced by renaming another file over it.
+class InotifyWatcher : public QObject
+{
+    Q_OBJECT
+
+    public:
+        explicit InotifyWatcher( QObject * parent = nullptr );
+        ~InotifyWatcher() override;
+
+        /**
+         * Start watching a file. The file doesn't need to exist, but its directory does.
+         *
+         * @param path The path to the file.
+         * @return true if the file is watched, false otherwise.
+         */
+        bool    addPath( const QString& path );
+
+        /**
+         * Stop watching a file.
+         *
+         * @param path The path to the file, as it was given to addPath.
+         * @return true if the file was watched, false otherwise.
+         */
+        bool    removePath( const QString& path );
+
+        /**
+         * @return The paths of all watched files.
+         */
+        QStringList files() const;
+
+    signals:
+        /**
+         * A watched file was written to, or replaced by another file.
+         *
+         * @param path The path to the file, as it was given to addPath.
+         */
+        void    fileChanged( const QString& path );
+
+    private slots:
+        // Reads all pending events from inotify and reports the changed files
+        void    readEvents();
+
+    private:
+        // Adds the directory watch, returns the watch descriptor or -1 on error
+        int     watchDirectory( const QString& directory );
+
+        // The inotify instance, or -1 if it could not be created
+        int     mInotifyFd;
+
+        QSocketNotifier * mNotifier;
+
+        // Maps the watch descriptors to the watched directories
+        QHash< int, QString >   mDirectories;
+
+        // Maps the watch descriptors to the names of the watched files in the directory,
+        // and the names to the paths which were given to addPath
+        QHash< int, QHash< QString, QString > > mWatchedNames;
+};
+
+#endif // INOTIFYWATCHER_H
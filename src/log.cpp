@@ -1,22 +1,111 @@
-#include <stdarg.h>
-
 #include <QDir>
 #include <QDateTime>
+#include <QEvent>
+#include <QPointer>
 #include <QStandardPaths>
 #include <QMessageBox>
 #include <QTextStream>
+#include <QThread>
 
 #include "log.h"
 #include "dialoglogoutput.h"
 
+// Writes the log entries in the background
+class LogWriter : public QThread
+{
+    public:
+        explicit LogWriter( Log * log ) : mLog( log ) {}
+
+    protected:
+        void run() override
+        {
+            mLog->writeEntries();
+        }
+
+    private:
+        Log *   mLog;
+};
+
+// The log entries which the writer thread wrote, for the log dialog
+class LogLinesEvent : public QEvent
+{
+    public:
+        static const QEvent::Type EventType;
+
+        LogLinesEvent( const QStringList &lines, qint64 firstEntry )
+            : QEvent( EventType ), mLines( lines ), mFirstEntry( firstEntry ) {}
+
+        const QStringList   mLines;
+
+        // The number of the first line among all entries of the log
+        const qint64        mFirstEntry;
+};
+
+const QEvent::Type LogLinesEvent::EventType = static_cast<QEvent::Type>( QEvent::registerEventType() );
+
+// Passes the log entries on to the log dialog. It lives in the GUI thread, which owns
+// the dialog, so the dialog is never touched by the writer thread.
+class LogDialogForwarder : public QObject
+{
+    public:
+        // Shows the entries in the dialog, they are the first shownEntries entries of the log
+        void    setDialog( DialogLogOutput * dialog, qint64 shownEntries )
+        {
+            mDialog = dialog;
+            mShownEntries = shownEntries;
+        }
+
+        bool    hasDialog() const { return !mDialog.isNull(); }
+
+        DialogLogOutput * dialog() const { return mDialog.data(); }
+
+        bool    event( QEvent * event ) override
+        {
+            if ( event->type() != LogLinesEvent::EventType )
+                return QObject::event( event );
+
+            const LogLinesEvent * linesEvent = static_cast<LogLinesEvent *>( event );
+
+            // The dialog got the entries which were written before it was opened already
+            const qint64 skipped = mShownEntries - linesEvent->mFirstEntry;
+
+            if ( !mDialog.isNull() && skipped < linesEvent->mLines.count() )
+            {
+                mDialog->add( skipped > 0 ? linesEvent->mLines.mid( static_cast<int>( skipped ) ) : linesEvent->mLines );
+                mShownEntries = linesEvent->mFirstEntry + linesEvent->mLines.count();
+            }
+
+            return true;
+        }
+
+    private:
+        // Auto-set to null when log dialog is closed
+        QPointer<DialogLogOutput>   mDialog;
+        qint64          mShownEntries = 0;
+};
+
 Log * Log::mLog;
+Log::Level Log::mMinimumLevel = Log::Level::Debug;
+
+Log::Log()
+    : mQueue( LOG_BUFFER_SIZE ), mOverflowPolicy( OverflowPolicy::Drop ), mEntryCount( 0 )
+{
+    mForwarder = new LogDialogForwarder();
+
+    if ( QCoreApplication::instance() )
+        mForwarder->moveToThread( QCoreApplication::instance()->thread() );
+
+    mWriter = new LogWriter( this );
+    mWriter->start();
+}
 
-void Log::initialize(const QString& path )
+void Log::initialize(const QString& path, OverflowPolicy policy )
 {
     if (mLog != nullptr)
         Log::fatal("Attempt to initialize initialized log");
 
     Log * self = g();
+    self->mOverflowPolicy = policy;
 
     if ( path.isEmpty() )
         return;
@@ -46,8 +135,11 @@ void Log::fatal( const QString& str )
 {
     Log * self = g();
 
-    // Add the log line
-    self->add( str );
+    // Add the log line, and wait until it is written
+    LogRecord record;
+    record.text = str;
+    self->add( record, false );
+    flush();
 
     // Write the whole log buffer into a file log.txt
     QFile file( QStandardPaths::writableLocation( QStandardPaths::TempLocation ) + QDir::separator() + "birdtray-log.txt" );
@@ -71,34 +163,31 @@ void Log::fatal( const QString& str )
     exit( 1 );
 }
 
-void Log::debug(const char *fmt, ... )
+void Log::setMinimumLevel( Level level )
 {
-    va_list vl;
-    char buf[4096];
-
-    va_start( vl, fmt );
-    vsnprintf( buf, sizeof(buf) - 1, fmt, vl );
-    va_end( vl );
-
-    // Add the log line
-    g()->add( buf );
+    mMinimumLevel = level;
 }
 
 void Log::showLogger()
 {
     Log * self = g();
 
-    QMutexLocker l( &self->mMutex );
+    LogDialogForwarder * forwarder = self->mForwarder;
 
     // Create a dialog if not exist
-    if ( self->mDialog.isNull() )
+    if ( !forwarder->hasDialog() )
     {
-        self->mDialog = new DialogLogOutput();
-        self->mDialog->add( self->mEntries );
-        self->mDialog->show();
+        DialogLogOutput * dialog = new DialogLogOutput();
+
+        QMutexLocker l( &self->mMutex );
+        dialog->add( self->mEntries );
+        forwarder->setDialog( dialog, self->mEntryCount );
+        l.unlock();
+
+        dialog->show();
     }
 
-    self->mDialog->activateWindow();
+    forwarder->dialog()->activateWindow();
 }
 
 Log *Log::g()
@@ -109,27 +198,115 @@ Log *Log::g()
     return mLog;
 }
 
-void Log::add(const QString &text)
+void Log::flush()
 {
-    // Prepend a timestamp
-    QDateTime now = QDateTime::currentDateTime();
-    QString logline = QString("%1 %2 ") .arg( now.toString( "yyyy-MM-dd hh:mm:ss" )) .arg(text);
+    Log * self = g();
+    int queued = self->mQueuedLines.loadAcquire();
 
-    QMutexLocker l( &mMutex );
+    while ( self->mWrittenLines.loadAcquire() - queued < 0 && !self->mWriter->isFinished() )
+        QThread::msleep( 1 );
+}
 
-    // Adding it to the log buffer
-    if ( mEntries.count() >= MAX_LOG_LINES )
-        mEntries.pop_front();
+void Log::shutdown()
+{
+    if ( mLog == nullptr )
+        return;
+
+    flush();
+
+    // Wake up the writer thread, it writes what was added meanwhile before it stops
+    mLog->mStopping.storeRelease( 1 );
+    mLog->mAvailable.release();
+    mLog->mWriter->wait();
+}
+
+int Log::droppedLines()
+{
+    return g()->mDroppedLines.loadAcquire();
+}
+
+void Log::add( LogRecord &record, bool mayDrop )
+{
+    record.time = QDateTime::currentMSecsSinceEpoch();
+
+    while ( !mQueue.push( record ) )
+    {
+        // Nobody makes room once the writer thread stopped
+        if ( ( mayDrop && mOverflowPolicy == OverflowPolicy::Drop ) || mWriter->isFinished() )
+        {
+            mDroppedLines.fetchAndAddRelaxed( 1 );
+            return;
+        }
+
+        // Wait for the writer thread to make room
+        QThread::yieldCurrentThread();
+    }
+
+    mQueuedLines.fetchAndAddRelease( 1 );
+    mAvailable.release();
+}
+
+void Log::writeEntries()
+{
+    int reportedDroppedLines = 0;
+
+    while ( true )
+    {
+        // Wait for a log entry, and take all others which were added meanwhile
+        mAvailable.acquire();
+        mAvailable.tryAcquire( mAvailable.available() );
+
+        QStringList lines;
+        LogRecord record;
+
+        while ( mQueue.pop( record ) )
+        {
+            // Format the line and prepend a timestamp
+            QDateTime time = QDateTime::fromMSecsSinceEpoch( record.time );
+            lines.append( QString("%1 %2 ") .arg( time.toString( "yyyy-MM-dd hh:mm:ss" )) .arg( record.message() ) );
+        }
+
+        if ( lines.isEmpty() )
+        {
+            if ( mStopping.loadAcquire() )
+                return;
 
-    mEntries.push_back( logline );
+            continue;
+        }
 
-    // Add it to the open log window, if any
-    if ( !mDialog.isNull() )
-        mDialog.data()->add( logline );
+        int writtenLines = lines.count();
+        int droppedLines = mDroppedLines.loadAcquire();
+
+        if ( droppedLines != reportedDroppedLines )
+        {
+            lines.append( QString("%1 %2 log lines were dropped, the log buffer was full")
+                    .arg( QDateTime::currentDateTime().toString( "yyyy-MM-dd hh:mm:ss" ))
+                    .arg( droppedLines - reportedDroppedLines ) );
+            reportedDroppedLines = droppedLines;
+        }
+
+        QMutexLocker l( &mMutex );
+
+        // Adding them to the log buffer
+        mEntries.append( lines );
+
+        if ( mEntries.count() > MAX_LOG_LINES )
+            mEntries.erase( mEntries.begin(), mEntries.begin() + ( mEntries.count() - MAX_LOG_LINES ) );
+
+        // Add them to the open log window, if any, in its thread
+        QCoreApplication::postEvent( mForwarder, new LogLinesEvent( lines, mEntryCount ) );
+        mEntryCount += lines.count();
+
+        // if log file is open, append to log file
+        if (mOutputFile.isOpen()) {
+            mOutputFile.write( (lines.join( "\r\n" ) + "\r\n").toUtf8() );
+            mOutputFile.flush();
+        }
+
+        l.unlock();
+        mWrittenLines.fetchAndAddRelease( writtenLines );
 
-    // if log file is open, append to log file
-    if (mOutputFile.isOpen()) {
-        mOutputFile.write( (logline + "\r\n").toUtf8() );
-        mOutputFile.flush();
+        if ( mStopping.loadAcquire() )
+            return;
     }
 }
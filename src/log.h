@@ -2,53 +2,178 @@
 #define LOG_H
 
 #include <QMutex>
-#include <QPointer>
 #include <QStringList>
 #include <QFile>
+#include <QSemaphore>
+#include <QAtomicInt>
 
-class DialogLogOutput;
+#include "logqueue.h"
 
-// Logger
+// The lowest log level which is compiled in, see Log::Level. The log macros of lower levels
+// expand to nothing but the format check.
+#ifndef BIRDTRAY_LOG_MIN_LEVEL
+#define BIRDTRAY_LOG_MIN_LEVEL 0
+#endif
+
+#define BIRDTRAY_LOG( level, ... ) \
+    do { \
+        if ( Log::isEnabled( level ) ) \
+            Log::write( __VA_ARGS__ ); \
+        else if ( false ) \
+            Log::checkFormat( __VA_ARGS__ ); \
+    } while ( false )
+
+#define BIRDTRAY_LOG_DISABLED( ... ) \
+    do { \
+        if ( false ) \
+            Log::checkFormat( __VA_ARGS__ ); \
+    } while ( false )
+
+// Adds a log entry with a printf-like format. The arguments are only evaluated if the level
+// is enabled, and the line is formatted by the writer thread.
+#if BIRDTRAY_LOG_MIN_LEVEL <= 0
+#define LOG_DEBUG( ... )    BIRDTRAY_LOG( Log::Level::Debug, __VA_ARGS__ )
+#else
+#define LOG_DEBUG( ... )    BIRDTRAY_LOG_DISABLED( __VA_ARGS__ )
+#endif
+
+#if BIRDTRAY_LOG_MIN_LEVEL <= 1
+#define LOG_INFO( ... )     BIRDTRAY_LOG( Log::Level::Info, __VA_ARGS__ )
+#else
+#define LOG_INFO( ... )     BIRDTRAY_LOG_DISABLED( __VA_ARGS__ )
+#endif
+
+#define LOG_WARNING( ... )  BIRDTRAY_LOG( Log::Level::Warning, __VA_ARGS__ )
+
+class LogDialogForwarder;
+class LogWriter;
+
+// Logger. The log lines are added to a lock-free buffer, and written to the log file
+// and the log dialog by a background thread. Use the LOG_* macros to add log lines.
 class Log final
 {
     public:
-        // Adds a log entry and terminates an app, writing the log buffer to log.txt
+        enum class Level
+        {
+            Debug,
+            Info,
+            Warning
+        };
+
+        // What happens to a log line if the log buffer is full
+        enum class OverflowPolicy
+        {
+            Drop,   // The line is dropped and counted
+            Block   // The caller waits until the writer thread made room
+        };
+
+        // Adds a log entry and terminates an app, writing the log buffer to log.txt.
+        // The entry is never dropped, whatever the overflow policy is.
         Q_NORETURN static void    fatal( const QString& str );
 
-        // Adds a debug log entry
-        static void    debug( const char * fmt, ... ) Q_ATTRIBUTE_FORMAT_PRINTF(1, 2);
+        // Whether log lines of this level are added
+        static bool    isEnabled( Level level )
+        {
+            return level >= mMinimumLevel;
+        }
+
+        // Sets the lowest level of the log lines which are added, this should be called before
+        // any other threads are started
+        static void    setMinimumLevel( Level level );
+
+        // Adds a log entry, the arguments are copied and formatted by the writer thread.
+        // The format must be a string literal.
+        template< typename... Args >
+        static void    write( const char * format, const Args&... args )
+        {
+            LogRecord record;
+            record.format = format;
+            record.arguments.reserve( static_cast<int>( sizeof...( args ) ) );
+
+            int expand[] = { 0, ( record.arguments.append( LogArgument( args ) ), 0 )... };
+            Q_UNUSED( expand );
+
+            g()->add( record );
+        }
+
+        // Lets the compiler check the format of the log macros, this is never called
+        static inline void checkFormat( const char * format, ... ) Q_ATTRIBUTE_FORMAT_PRINTF(1, 2);
 
         // Shows the logging widget
         static void    showLogger();
 
         // Initializes log with/without a file output
-        static void    initialize( const QString& path = "" );
+        static void    initialize( const QString& path = "", OverflowPolicy policy = OverflowPolicy::Drop );
+
+        // Waits until all log entries which were added so far are written
+        static void    flush();
+
+        // Writes the remaining log entries and stops the writer thread. Call this when the
+        // application exits, log entries which are added afterwards are not written.
+        static void    shutdown();
+
+        // Returns the number of log lines which were dropped because the log buffer was full
+        static int     droppedLines();
 
     private:
+        friend class LogWriter;
+
         // Only keep this number of last log lines in buffer
         static const int MAX_LOG_LINES = 500;
 
+        // The number of log lines which can wait for the writer thread
+        static const int LOG_BUFFER_SIZE = 1024;
+
         static Log *    mLog;
 
+        static Level    mMinimumLevel;
+
         // Singleton getter
         static Log *g();
 
-        // Add a log entry
-        void    add( const QString& text );
+        // Add a log entry, moving the record into the buffer. If mayDrop is false, the entry
+        // isn't dropped if the buffer is full, regardless of the overflow policy.
+        void    add( LogRecord &record, bool mayDrop = true );
+
+        // Writes the log entries from the buffer, this runs in the writer thread
+        void    writeEntries();
 
         // Internal stuff
-        Log()  = default;
+        Log();
         ~Log() = default;
         Log( const Log& l) = delete;
         Log operator= ( const Log& l) = delete;
 
+        // The log entries waiting for the writer thread, and their count
+        LogQueue        mQueue;
+        QSemaphore      mAvailable;
+
+        OverflowPolicy  mOverflowPolicy;
+        QAtomicInt      mDroppedLines;
+
+        // Number of log entries added to the buffer, and written by the writer thread
+        QAtomicInt      mQueuedLines;
+        QAtomicInt      mWrittenLines;
+
+        LogWriter *     mWriter;
+
+        // Set to stop the writer thread
+        QAtomicInt      mStopping;
+
         // All historic log entries are stored here, guarded by mMutex
         QStringList     mEntries;
         QMutex          mMutex;
         QFile           mOutputFile;
 
-        // Auto-set to null when log dialog is closed
-        QPointer<DialogLogOutput>   mDialog;
+        // The number of log entries which were ever added to mEntries, guarded by mMutex
+        qint64          mEntryCount;
+
+        // Passes the written entries on to the log dialog, in the GUI thread
+        LogDialogForwarder *    mForwarder;
 };
 
+inline void Log::checkFormat( const char *, ... )
+{
+}
+
 #endif // LOG_H
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "logqueue.h"
+
+qint64 LogArgument::toSigned() const
+{
+    switch ( mType )
+    {
+        case Type::Signed:
+            return mValue.i;
+
+        case Type::Unsigned:
+            return static_cast<qint64>( mValue.u );
+
+        case Type::Double:
+            return static_cast<qint64>( mValue.d );
+
+        default:
+            return static_cast<qint64>( reinterpret_cast<quintptr>( mValue.p ) );
+    }
+}
+
+quint64 LogArgument::toUnsigned() const
+{
+    if ( mType == Type::Double )
+        return static_cast<quint64>( mValue.d );
+
+    quint64 value = static_cast<quint64>( toSigned() );
+
+    if ( mSize < static_cast<int>( sizeof( quint64 ) ) )
+        value &= ( Q_UINT64_C( 1 ) << ( mSize * 8 ) ) - 1;
+
+    return value;
+}
+
+double LogArgument::toDouble() const
+{
+    switch ( mType )
+    {
+        case Type::Double:
+            return mValue.d;
+
+        case Type::Unsigned:
+            return static_cast<double>( mValue.u );
+
+        default:
+            return static_cast<double>( toSigned() );
+    }
+}
+
+// Formats a single value with the given printf conversion, and appends it to the result
+template< typename T >
+static void appendFormatted( QByteArray &result, const QByteArray &conversion, T value )
+{
+    char buffer[ 64 ];
+    int length = snprintf( buffer, sizeof( buffer ), conversion.constData(), value );
+
+    if ( length < 0 )
+        return;
+
+    if ( length < static_cast<int>( sizeof( buffer ) ) )
+    {
+        result.append( buffer, length );
+        return;
+    }
+
+    // Long strings or wide fields
+    QByteArray large( length + 1, Qt::Uninitialized );
+    snprintf( large.data(), large.size(), conversion.constData(), value );
+    result.append( large.constData(), length );
+}
+
+QString LogRecord::message() const
+{
+    if ( format == nullptr )
+        return text;
+
+    QByteArray result;
+    int nextArgument = 0;
+    const char * ptr = format;
+
+    while ( *ptr != '\0' )
+    {
+        const char * start = ptr;
+
+        if ( *ptr != '%' )
+        {
+            while ( *ptr != '\0' && *ptr != '%' )
+                ptr++;
+
+            result.append( start, static_cast<int>( ptr - start ) );
+            continue;
+        }
+
+        if ( ptr[1] == '%' )
+        {
+            result.append( '%' );
+            ptr += 2;
+            continue;
+        }
+
+        // Keep the flags, the width and the precision. The length modifier is replaced,
+        // as the arguments are stored in 64 bits, only h and hh narrow the argument.
+        ptr++;
+
+        while ( *ptr != '\0' && strchr( "-+ #0123456789.", *ptr ) != nullptr )
+            ptr++;
+
+        QByteArray conversion( start, static_cast<int>( ptr - start ) );
+        int shortModifiers = 0;
+
+        while ( *ptr != '\0' && strchr( "hlLqjzt", *ptr ) != nullptr )
+        {
+            if ( *ptr == 'h' )
+                shortModifiers++;
+
+            ptr++;
+        }
+
+        if ( *ptr == '\0' )
+        {
+            // Truncated conversion at the end of the format
+            result.append( start );
+            break;
+        }
+
+        const char type = *ptr++;
+
+        if ( strchr( "diuxXocfeEgGsp", type ) == nullptr )
+        {
+            // Not a conversion we know, keep it as is
+            result.append( start, static_cast<int>( ptr - start ) );
+            continue;
+        }
+
+        if ( nextArgument >= arguments.size() )
+        {
+            result.append( "<missing>" );
+            continue;
+        }
+
+        const LogArgument &argument = arguments[ nextArgument++ ];
+
+        switch ( type )
+        {
+            case 'd':
+            case 'i':
+            {
+                long long value = argument.toSigned();
+
+                if ( shortModifiers == 1 )
+                    value = static_cast<short>( value );
+                else if ( shortModifiers > 1 )
+                    value = static_cast<signed char>( value );
+
+                appendFormatted( result, conversion + "lld", value );
+                break;
+            }
+
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+            {
+                unsigned long long value = argument.toUnsigned();
+
+                if ( shortModifiers == 1 )
+                    value = static_cast<unsigned short>( value );
+                else if ( shortModifiers > 1 )
+                    value = static_cast<unsigned char>( value );
+
+                appendFormatted( result, conversion + "ll" + type, value );
+                break;
+            }
+
+            case 'c':
+                appendFormatted( result, conversion + type, static_cast<int>( argument.toSigned() ) );
+                break;
+
+            case 's':
+                appendFormatted( result, conversion + type, argument.toString() != nullptr ? argument.toString() : "(null)" );
+                break;
+
+            case 'p':
+                appendFormatted( result, conversion + type, argument.toPointer() );
+                break;
+
+            default:
+                appendFormatted( result, conversion + type, argument.toDouble() );
+                break;
+        }
+    }
+
+    return QString::fromUtf8( result );
+}
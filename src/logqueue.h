@@ -0,0 +1,182 @@
+#ifndef LOGQUEUE_H
+#define LOGQUEUE_H
+
+#include <QAtomicInteger>
+#include <QScopedArrayPointer>
+#include <QByteArray>
+#include <QString>
+#include <QVarLengthArray>
+
+#include <type_traits>
+#include <utility>
+
+// An argument of a log line. The value is copied when the line is logged, strings included,
+// so the line can be formatted later by the writer thread.
+class LogArgument
+{
+    public:
+        enum class Type
+        {
+            Signed,
+            Unsigned,
+            Double,
+            String,
+            Pointer
+        };
+
+        LogArgument() : mType( Type::Signed ), mSize( sizeof( int ) ) { mValue.i = 0; }
+
+        template< typename T, typename std::enable_if< std::is_integral<T>::value && std::is_signed<T>::value, int >::type = 0 >
+        LogArgument( T value ) : mType( Type::Signed ), mSize( promotedSize( sizeof( T ) ) ) { mValue.i = value; }
+
+        template< typename T, typename std::enable_if< std::is_integral<T>::value && std::is_unsigned<T>::value, int >::type = 0 >
+        LogArgument( T value ) : mType( Type::Unsigned ), mSize( promotedSize( sizeof( T ) ) ) { mValue.u = value; }
+
+        template< typename T, typename std::enable_if< std::is_enum<T>::value, int >::type = 0 >
+        LogArgument( T value ) : mType( Type::Signed ), mSize( promotedSize( sizeof( T ) ) ) { mValue.i = static_cast<qint64>( value ); }
+
+        template< typename T, typename std::enable_if< std::is_floating_point<T>::value, int >::type = 0 >
+        LogArgument( T value ) : mType( Type::Double ), mSize( sizeof( double ) ) { mValue.d = value; }
+
+        // Pointers to characters are strings, all other pointers are printed as addresses
+        template< typename T, typename std::enable_if< !std::is_same< typename std::remove_cv<T>::type, char >::value, int >::type = 0 >
+        LogArgument( T * value ) : mType( Type::Pointer ), mSize( sizeof( value ) ) { mValue.p = value; }
+
+        LogArgument( const char * value ) : mType( Type::String ), mSize( sizeof( value ) ), mString( value )
+        {
+            mValue.p = value;
+        }
+
+        Type    type() const { return mType; }
+
+        // The size in bytes of the argument as printf would get it, after the integer promotions
+        int     size() const { return mSize; }
+
+        qint64  toSigned() const;
+
+        // The value converted to an unsigned integer of the size of the argument,
+        // so a negative int is printed with 32 bits like printf does
+        quint64 toUnsigned() const;
+        double  toDouble() const;
+        const void * toPointer() const { return mType == Type::String || mType == Type::Pointer ? mValue.p : nullptr; }
+
+        // The string value, nullptr for a null string or an argument which is not a string
+        const char * toString() const { return mType == Type::String && mValue.p != nullptr ? mString.constData() : nullptr; }
+
+    private:
+        static int promotedSize( size_t size ) { return static_cast<int>( size < sizeof( int ) ? sizeof( int ) : size ); }
+
+        Type    mType;
+        int     mSize;
+
+        union
+        {
+            qint64          i;
+            quint64         u;
+            double          d;
+            const void *    p;
+        } mValue;
+
+        // The copy of a string argument
+        QByteArray  mString;
+};
+
+// A log line which waits to be written
+struct LogRecord
+{
+    // Milliseconds since the epoch when the line was logged
+    qint64  time = 0;
+
+    // The printf-like format of the line and its arguments. If the format is nullptr,
+    // the line is already formatted in text. The format must be a string literal.
+    const char * format = nullptr;
+    QVarLengthArray< LogArgument, 6 > arguments;
+
+    QString text;
+
+    // Formats the line
+    QString message() const;
+};
+
+// A bounded queue of log records, which any number of threads can add to without taking a lock,
+// and a single thread takes the records from. Each slot has a sequence number which tells whether
+// it is free for the producer at a position, or filled for the consumer.
+class LogQueue
+{
+    public:
+        // The capacity must be a power of two
+        explicit LogQueue( int capacity )
+            : mSlots( new Slot[ capacity ] ), mMask( static_cast<quint32>( capacity ) - 1 ), mDequeuePos( 0 )
+        {
+            for ( int i = 0; i < capacity; i++ )
+                mSlots[i].sequence.storeRelease( static_cast<quint32>( i ) );
+        }
+
+        // Adds the record, moving it into the queue. Returns false and leaves the record
+        // untouched if the queue is full. Can be called from any thread.
+        bool push( LogRecord &record )
+        {
+            quint32 pos = mEnqueuePos.loadAcquire();
+            Slot * slot;
+
+            while ( true )
+            {
+                slot = &mSlots[ pos & mMask ];
+                qint32 diff = static_cast<qint32>( slot->sequence.loadAcquire() - pos );
+
+                if ( diff == 0 )
+                {
+                    // The slot is free, claim the position; on failure pos is updated to the current one
+                    if ( mEnqueuePos.testAndSetRelaxed( pos, pos + 1, pos ) )
+                        break;
+                }
+                else if ( diff < 0 )
+                {
+                    // The consumer didn't take the record of the previous round yet
+                    return false;
+                }
+                else
+                {
+                    pos = mEnqueuePos.loadAcquire();
+                }
+            }
+
+            slot->record = std::move( record );
+            slot->sequence.storeRelease( pos + 1 );
+            return true;
+        }
+
+        // Takes the oldest record. Returns false if the queue is empty.
+        // Must only be called from a single thread.
+        bool pop( LogRecord &record )
+        {
+            Slot * slot = &mSlots[ mDequeuePos & mMask ];
+
+            if ( static_cast<qint32>( slot->sequence.loadAcquire() - ( mDequeuePos + 1 ) ) != 0 )
+                return false;
+
+            record = std::move( slot->record );
+            slot->record = LogRecord();
+            slot->sequence.storeRelease( mDequeuePos + mMask + 1 );
+            mDequeuePos++;
+            return true;
+        }
+
+    private:
+        struct Slot
+        {
+            QAtomicInteger<quint32> sequence;
+            LogRecord               record;
+        };
+
+        QScopedArrayPointer<Slot>   mSlots;
+        const quint32               mMask;
+
+        // The next position to fill, shared by the producers
+        QAtomicInteger<quint32>     mEnqueuePos;
+
+        // The next position to take, only used by the consumer
+        quint32                     mDequeuePos;
+};
+
+#endif // LOGQUEUE_H
@@ -0,0 +1,63 @@
+#include "morkatomtable.h"
+
+MorkAtomTable::MorkAtomTable()
+{
+    names_.append( QByteArray() );
+}
+
+MorkAtomTable & MorkAtomTable::instance()
+{
+    static MorkAtomTable table;
+    return table;
+}
+
+int MorkAtomTable::intern( const char * name, int length )
+{
+    // Known names are looked up without copying them
+    const QByteArray key = QByteArray::fromRawData( name, length );
+    const int atom = find( key );
+
+    if ( atom )
+        return atom;
+
+    MorkAtomTable &table = instance();
+    QWriteLocker locker( &table.lock_ );
+
+    // Another thread may have added the name in the meantime
+    QHash< QByteArray, int >::const_iterator it = table.atoms_.constFind( key );
+
+    if ( it != table.atoms_.cend() )
+        return it.value();
+
+    const QByteArray copy( name, length );
+    const int newAtom = table.names_.size();
+    table.names_.append( copy );
+    table.atoms_.insert( copy, newAtom );
+    return newAtom;
+}
+
+int MorkAtomTable::intern( const QByteArray &name )
+{
+    return intern( name.constData(), name.size() );
+}
+
+int MorkAtomTable::find( const QByteArray &name )
+{
+    MorkAtomTable &table = instance();
+    QReadLocker locker( &table.lock_ );
+    return table.atoms_.value( name, 0 );
+}
+
+QByteArray MorkAtomTable::name( int atom )
+{
+    MorkAtomTable &table = instance();
+    QReadLocker locker( &table.lock_ );
+    return atom > 0 && atom < table.names_.size() ? table.names_.at( atom ) : QByteArray();
+}
+
+int MorkAtomTable::size()
+{
+    MorkAtomTable &table = instance();
+    QReadLocker locker( &table.lock_ );
+    return table.names_.size() - 1;
+}
@@ -0,0 +1,43 @@
+#ifndef MORKATOMTABLE_H
+#define MORKATOMTABLE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QVector>
+
+// Interns the column names of mork files. Every name gets an atom, a number which stays the same
+// for the lifetime of the process. The mork files of a profile all define nearly the same columns,
+// so their parsers share one table and compare the column names as atoms.
+// The table can be used from any thread.
+class MorkAtomTable
+{
+public:
+    // Returns the atom of the name, which is added if it isn't known yet. Atoms are never 0.
+    static int  intern( const char * name, int length );
+    static int  intern( const QByteArray &name );
+
+    // Returns the atom of the name, or 0 if the name isn't known
+    static int  find( const QByteArray &name );
+
+    // Returns the name of the atom, or an empty array if there is no such atom
+    static QByteArray name( int atom );
+
+    // Returns the number of interned names
+    static int  size();
+
+private:
+    MorkAtomTable();
+
+    static MorkAtomTable & instance();
+
+    QReadWriteLock lock_;
+
+    // Maps the names to their atoms
+    QHash< QByteArray, int > atoms_;
+
+    // The names by atom, the atom 0 has no name
+    QVector< QByteArray > names_;
+};
+
+#endif // MORKATOMTABLE_H
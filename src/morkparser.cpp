@@ -27,10 +27,17 @@
 
 
 #include "morkparser.h"
+#include "morkatomtable.h"
 #include "utils.h"
 #include <QtCore>
+#include <algorithm>
+#include <limits>
 #include <utility>
 
+#ifndef Q_OS_WIN
+#include <sys/stat.h>
+#endif /* Q_OS_WIN */
+
 #include "log.h"
 
 /**
@@ -62,43 +69,386 @@ private:
     const QString message;
 };
 
+/**
+ * @param path The path to a file.
+ * @return An identity of the file, which changes if the file is replaced by another file.
+ */
+static quint64 getFileIdentity( const QString &path )
+{
+#ifdef Q_OS_WIN
+    // There are no inodes, but a replacement file has a new creation time
+    return static_cast<quint64>( QFileInfo( path ).created().toMSecsSinceEpoch() );
+#else
+    struct stat info;
+
+    if ( stat( QFile::encodeName( path ).constData(), &info ) != 0 )
+        return 0;
+
+    return static_cast<quint64>( info.st_ino );
+#endif /* Q_OS_WIN */
+}
+
+// Returns the value of the hex digit, or -1 if the char is no hex digit
+static inline int hexDigitValue( char c )
+{
+    if ( c >= '0' && c <= '9' )
+        return c - '0';
+
+    c |= 0x20;
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+// Converts the hex number to an int like QByteArray::toInt( ok, 16 ),
+// but without copying the data. Returns 0 if it is not a number.
+static int hexToInt( const char * data, int length, bool * ok )
+{
+    const char * end = data + length;
+
+    while ( data < end && isspace( static_cast<unsigned char>( *data ) ) )
+        data++;
+
+    while ( end > data && isspace( static_cast<unsigned char>( end[ -1 ] ) ) )
+        end--;
+
+    const bool negative = data < end && *data == '-';
+
+    if ( data < end && ( *data == '-' || *data == '+' ) )
+        data++;
+
+    if ( end - data > 2 && data[ 0 ] == '0' && ( data[ 1 ] | 0x20 ) == 'x' && hexDigitValue( data[ 2 ] ) >= 0 )
+        data += 2;
+
+    qint64 value = 0;
+    bool valid = data < end;
+
+    for ( ; valid && data < end; data++ )
+    {
+        const int digit = hexDigitValue( *data );
+        value = value * 16 + digit;
+        valid = digit >= 0 && value <= Q_INT64_C( 0x80000000 );
+    }
+
+    if ( negative )
+        value = -value;
+
+    valid = valid && value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max();
+
+    if ( ok )
+        *ok = valid;
+
+    return valid ? static_cast<int>( value ) : 0;
+}
+
+// The format version of the scanner checkpoints, which must be increased whenever their content changes
+static const quint32 CheckpointVersion = 1;
+
+// The size of the start of a mork file whose hash is kept in the checkpoints
+static const int CheckpointPrefixSize = 4096;
+
+// Packs the scope and id of a row into the key of MorkParser::rowMappings
+static inline quint64 rowMappingKey( int rowScope, int rowId )
+{
+    return ( static_cast<quint64>( static_cast<uint>( rowScope ) ) << 32 ) | static_cast<uint>( rowId );
+}
+
 //	=============================================================
-//	MorkParser::MorkParser
+//	MorkRowStore
 
-MorkParser::MorkParser( int DefaultScope )
+// Hashes the packed table and row keys of a row
+static inline uint hashRowKey( int tableScope, int tableId, int rowScope, int rowId )
+{
+    quint64 hash = ( static_cast<quint64>( static_cast<uint>( tableScope ) ) << 32 ) | static_cast<uint>( tableId );
+    hash *= Q_UINT64_C( 0x9E3779B97F4A7C15 );
+    hash ^= ( static_cast<quint64>( static_cast<uint>( rowScope ) ) << 32 ) | static_cast<uint>( rowId );
+    hash ^= hash >> 29;
+    hash *= Q_UINT64_C( 0xBF58476D1CE4E5B9 );
+    hash ^= hash >> 32;
+    return static_cast<uint>( hash );
+}
+
+MorkRowStore::MorkRowStore()
+{
+}
+
+void MorkRowStore::clear()
+{
+    rows_.clear();
+    cells_.clear();
+    index_.clear();
+}
+
+int MorkRowStore::findSlot( int tableScope, int tableId, int rowScope, int rowId ) const
+{
+    // The index size is a power of two and it is never full, so probing ends at an empty slot
+    const int mask = index_.size() - 1;
+    int slot = static_cast<int>( hashRowKey( tableScope, tableId, rowScope, rowId ) & static_cast<uint>( mask ) );
+
+    while ( index_[ slot ] )
+    {
+        const MorkRow &row = rows_[ index_[ slot ] - 1 ];
+
+        if ( row.rowId == rowId && row.rowScope == rowScope && row.tableId == tableId && row.tableScope == tableScope )
+            break;
+
+        slot = ( slot + 1 ) & mask;
+    }
+
+    return slot;
+}
+
+int MorkRowStore::findRow( int tableScope, int tableId, int rowScope, int rowId ) const
+{
+    if ( index_.isEmpty() )
+        return -1;
+
+    return index_[ findSlot( tableScope, tableId, rowScope, rowId ) ] - 1;
+}
+
+int MorkRowStore::insertRow( int tableScope, int tableId, int rowScope, int rowId )
+{
+    // Keep the load factor of the index at or below one half
+    if ( ( rows_.size() + 1 ) * 2 > index_.size() )
+        growIndex();
+
+    const int slot = findSlot( tableScope, tableId, rowScope, rowId );
+
+    if ( index_[ slot ] )
+        return index_[ slot ] - 1;
+
+    MorkRow row;
+    row.tableScope = tableScope;
+    row.tableId = tableId;
+    row.rowScope = rowScope;
+    row.rowId = rowId;
+    row.firstCell = cells_.size();
+    row.cellCount = 0;
+    row.cellCapacity = 0;
+
+    rows_.append( row );
+    index_[ slot ] = rows_.size();
+    return rows_.size() - 1;
+}
+
+void MorkRowStore::growIndex()
+{
+    index_.fill( 0, qMax( 64, index_.size() * 2 ) );
+
+    for ( int i = 0; i < rows_.size(); i++ )
+    {
+        const MorkRow &row = rows_[ i ];
+        index_[ findSlot( row.tableScope, row.tableId, row.rowScope, row.rowId ) ] = i + 1;
+    }
+}
+
+void MorkRowStore::setCell( int row, int column, int value )
+{
+    MorkRow &r = rows_[ row ];
+    MorkCell * cells = cells_.data() + r.firstCell;
+
+    for ( int i = 0; i < r.cellCount; i++ )
+    {
+        if ( cells[ i ].column == column )
+        {
+            cells[ i ].value = value;
+            return;
+        }
+    }
+
+    appendCell( row, column, value );
+}
+
+void MorkRowStore::appendCell( int row, int column, int value )
+{
+    MorkRow &r = rows_[ row ];
+    MorkCell cell;
+    cell.column = column;
+    cell.value = value;
+
+    if ( r.cellCount < r.cellCapacity )
+    {
+        cells_[ r.firstCell + r.cellCount ] = cell;
+    }
+    else if ( r.firstCell + r.cellCapacity == cells_.size() )
+    {
+        // The row is at the end of the storage, which is the case while parsing it
+        // for the first time. It can simply grow.
+        cells_.append( cell );
+        r.cellCapacity++;
+    }
+    else
+    {
+        // Move the row to the end of the storage, so it can grow
+        const int firstCell = cells_.size();
+        cells_.resize( firstCell + r.cellCount );
+        std::copy( cells_.constData() + r.firstCell, cells_.constData() + r.firstCell + r.cellCount,
+                   cells_.data() + firstCell );
+        cells_.append( cell );
+        r.firstCell = firstCell;
+        r.cellCapacity = r.cellCount + 1;
+    }
+
+    r.cellCount++;
+}
+
+void MorkRowStore::clearCells( int row )
+{
+    rows_[ row ].cellCount = 0;
+}
+
+qint64 MorkRowStore::memoryUsage() const
+{
+    return static_cast<qint64>( rows_.capacity() ) * sizeof( MorkRow )
+         + static_cast<qint64>( cells_.capacity() ) * sizeof( MorkCell )
+         + static_cast<qint64>( index_.capacity() ) * sizeof( int );
+}
+
+//	=============================================================
+//	MorkColumnSet
+
+MorkColumnSet::MorkColumnSet()
+{
+    generation_ = 1;
+}
+
+void MorkColumnSet::clear()
+{
+    otherColumns_.clear();
+
+    if ( ++generation_ == 0 )
+    {
+        // The generations wrapped around, so old marks could match again
+        generations_.fill( 0 );
+        generation_ = 1;
+    }
+}
+
+bool MorkColumnSet::insert( int column )
+{
+    if ( column < 0 || column >= MaxTableSize )
+    {
+        if ( otherColumns_.contains( column ) )
+            return false;
+
+        otherColumns_.append( column );
+        return true;
+    }
+
+    if ( column >= generations_.size() )
+    {
+        // Grow to the next power of two, so the table settles at the size of the columns in use
+        int size = qMax( 256, generations_.size() );
+
+        while ( size <= column )
+            size *= 2;
+
+        generations_.resize( size );
+    }
+
+    if ( generations_[ column ] == generation_ )
+        return false;
+
+    generations_[ column ] = generation_;
+    return true;
+}
+
+//	=============================================================
+//	MorkHandler
+
+MorkHandler::~MorkHandler()
+{
+}
+
+void MorkHandler::onDictEntry( MorkDictType, int, const MorkLiteral & )
+{
+}
+
+void MorkHandler::onTableBegin( int, int )
+{
+}
+
+void MorkHandler::onTableEnd()
+{
+}
+
+bool MorkHandler::onRowBegin( int, int, int, int )
+{
+    return true;
+}
+
+void MorkHandler::onRowCut()
+{
+}
+
+void MorkHandler::onCell( int, const MorkLiteral &, bool )
+{
+}
+
+void MorkHandler::onRowEnd()
+{
+}
+
+void MorkHandler::onRowReference( int, int, int, int )
+{
+}
+
+void MorkHandler::onGroupBegin()
+{
+}
+
+void MorkHandler::onGroupCommit()
+{
+}
+
+//	=============================================================
+//	MorkReader::MorkReader
+
+MorkReader::MorkReader( MorkHandler * handler, int DefaultScope )
 {
+    handler_ = handler;
+    morkData_ = 0;
+    morkEnd_ = 0;
+    structuralImplementation_ = MorkStructuralIndex::Implementation::Best;
     initVars();
     defaultScope_ = DefaultScope;
 }
 
+MorkReader::~MorkReader()
+{
+    closeData();
+}
+
 //	=============================================================
-//	MorkParser::open
+//	MorkReader::open
 
-bool MorkParser::open( const QString &path )
+bool MorkReader::open( const QString &path )
 {
+    closeData();
     initVars();
 
-    QFile MorkFile( path );
+    morkFile_.setFileName( path );
 
     // Open file
-    if ( !MorkFile.exists() || !MorkFile.open( QIODevice::ReadOnly ) )
+    if ( !morkFile_.exists() || !morkFile_.open( QIODevice::ReadOnly ) )
     {
         mErrorMessage = QCoreApplication::translate(
-                "MorkParser", "Couldn't open file: ") + MorkFile.errorString();
+                "MorkParser", "Couldn't open file: ") + morkFile_.errorString();
         return false;
     }
 
+    // Map the whole file, the literals are parsed as views into the mapping
+    loadData( 0, morkFile_.size() );
+
     // Check magic header
-    QByteArray MagicHeader = MorkFile.readLine();
+    const char * lineEnd = static_cast<const char *>( memchr( morkData_, '\n', morkEnd_ ) );
+    int headerLength = lineEnd ? static_cast<int>( lineEnd - morkData_ ) + 1 : morkEnd_;
 
-    if ( !MagicHeader.contains( MorkMagicHeader ) )
+    if ( !QByteArray::fromRawData( morkData_, headerLength ).contains( MorkMagicHeader ) )
     {
         mErrorMessage = QCoreApplication::translate("MorkParser", "Unsupported version.");
         return false;
     }
 
-    morkData_ = MorkFile.readAll();
-    MorkFile.close();
+    morkPos_ = headerLength;
 
     // Parse mork
     try {
@@ -111,28 +461,68 @@ bool MorkParser::open( const QString &path )
 }
 
 //	=============================================================
-//	MorkParser::error
+//	MorkReader::error
 
-QString MorkParser::errorMsg()
+QString MorkReader::errorMsg()
 {
     return mErrorMessage;
 }
 
 //	=============================================================
-//	MorkParser::initVars
+//	MorkReader::initVars
 
-void MorkParser::initVars()
+void MorkReader::initVars()
 {
     morkPos_ = 0;
+    groupEndScanLength_ = 0;
+    mErrorMessage.clear();
     nowParsing_ = NPValues;
-    currentCells_ = 0;
-    nextAddValueId_ = 0x7fffffff;
 }
 
 //	=============================================================
-//	MorkParser::parse
+//	MorkReader::closeData
+
+void MorkReader::closeData()
+{
+    morkFile_.close();
+    morkBuffer_.clear();
+    morkData_ = 0;
+    morkEnd_ = 0;
+    structural_.reset( 0, 0 );
+}
+
+//	=============================================================
+//	MorkReader::loadData
+
+void MorkReader::loadData( qint64 offset, qint64 length )
+{
+    uchar * mapped = 0;
+
+    if ( length > 0 && length <= std::numeric_limits<int>::max() )
+        mapped = morkFile_.map( offset, length );
+
+    if ( mapped )
+    {
+        morkData_ = reinterpret_cast<const char *>( mapped );
+        morkEnd_ = static_cast<int>( length );
+    }
+    else
+    {
+        // The file cannot be mapped (i.e. it is empty or on a special file system), so read it
+        morkFile_.seek( offset );
+        morkBuffer_ = morkFile_.read( length );
+        morkFile_.close();
+        morkData_ = morkBuffer_.constData();
+        morkEnd_ = morkBuffer_.size();
+    }
+
+    structural_.reset( morkData_, morkEnd_, structuralImplementation_ );
+}
+
+//	=============================================================
+//	MorkReader::parse
 
-void MorkParser::parse()
+void MorkReader::parse()
 {
     // Run over mork chars and parse each term
     char cur = nextChar();
@@ -184,9 +574,9 @@ void MorkParser::parse()
 }
 
 //	=============================================================
-//	MorkParser::isWhiteSpace
+//	MorkReader::isWhiteSpace
 
-bool MorkParser::isWhiteSpace( char c )
+bool MorkReader::isWhiteSpace( char c )
 {
     switch ( c )
     {
@@ -202,13 +592,13 @@ bool MorkParser::isWhiteSpace( char c )
 }
 
 //	=============================================================
-//	MorkParser::nextChar
+//	MorkReader::nextChar
 
-inline char MorkParser::nextChar()
+inline char MorkReader::nextChar()
 {
     char cur = 0;
 
-    if ( morkPos_ < morkData_.length() )
+    if ( morkPos_ < morkEnd_ )
     {
         cur = morkData_[ morkPos_ ];
         morkPos_++;
@@ -222,7 +612,16 @@ inline char MorkParser::nextChar()
     return cur;
 }
 
-void MorkParser::skip( const char * string )
+//	=============================================================
+//	MorkReader::nextStructuralChar
+
+inline char MorkReader::nextStructuralChar()
+{
+    morkPos_ = qMin( structural_.next( morkPos_ ), morkEnd_ );
+    return nextChar();
+}
+
+void MorkReader::skip( const char * string )
 {
     while ( *string )
     {
@@ -233,42 +632,30 @@ void MorkParser::skip( const char * string )
     }
 }
 
-QChar MorkParser::readNext()
-{
-    QChar ch = peekNext();
-    morkPos_++;
-    return ch;
-}
-
-QChar MorkParser::peekNext()
-{
-    if (morkPos_ >= morkData_.length()) {
-        throw MorkParserException(QCoreApplication::translate("MorkParser", "Unexpected EOF."));
-    }
-    return QChar( morkData_[ morkPos_ ] );
-}
-
-QString MorkParser::readHexNumber()
+MorkLiteral MorkReader::readHexNumber()
 {
-    QString out;
+    MorkLiteral out( morkPos_ );
 
-    while ( true )
+    while ( morkPos_ < morkEnd_ && isalnum( static_cast<unsigned char>( morkData_[ morkPos_ ] ) ) )
     {
-        QChar ch = peekNext();
-
-        if ( !ch.isLetterOrNumber() )
-            return out;
+        morkPos_++;
+    }
 
-        out.append( readNext() );
+    if (morkPos_ >= morkEnd_) {
+        throw MorkParserException(QCoreApplication::translate("MorkParser", "Unexpected EOF."));
     }
+
+    out.length = morkPos_ - out.offset;
+    return out;
 }
 
 //	=============================================================
-//	MorkParser::parseDict
+//	MorkReader::parseDict
 
-void MorkParser::parseDict()
+void MorkReader::parseDict()
 {
-    char cur = nextChar();
+    // Only structural chars have a meaning in a dict, the others are jumped over
+    char cur = nextStructuralChar();
     nowParsing_ = NPValues;
 
     while ( cur != '>' && cur )
@@ -278,12 +665,15 @@ void MorkParser::parseDict()
             switch ( cur )
             {
             case '<':
-                if (morkData_.mid(morkPos_ - 1, static_cast<int>(strlen(MorkDictColumnMeta)))
-                    == MorkDictColumnMeta) {
+            {
+                const int metaLength = static_cast<int>(strlen(MorkDictColumnMeta));
+                if (morkEnd_ - (morkPos_ - 1) >= metaLength
+                    && memcmp(morkData_ + morkPos_ - 1, MorkDictColumnMeta, metaLength) == 0) {
                     nowParsing_ = NPColumns;
-                    morkPos_ += static_cast<int>(strlen(MorkDictColumnMeta)) - 1;
+                    morkPos_ += metaLength - 1;
                 }
                 break;
+            }
             case '(':
                 parseCell();
                 break;
@@ -295,14 +685,14 @@ void MorkParser::parseDict()
             }
         }
 
-        cur = nextChar();
+        cur = nextStructuralChar();
     }
 }
 
 //	=============================================================
-//	MorkParser::parseComment
+//	MorkReader::parseComment
 
-inline void MorkParser::parseComment()
+inline void MorkReader::parseComment()
 {
     char cur = nextChar();
 
@@ -312,155 +702,251 @@ inline void MorkParser::parseComment()
 
     while ( cur != '\r' && cur != '\n' && cur )
     {
-        cur = nextChar();
+        cur = nextStructuralChar();
     }
 }
 
 //	=============================================================
-//	MorkParser::parseCell
+//	MorkReader::parseCell
 
-void MorkParser::parseCell(QList<int>* parsedIds)
+void MorkReader::parseCell(MorkColumnSet* parsedIds)
 {
-    //bool bColumnOid = false;
+    MorkLiteral Column, Text;
     bool bValueOid = false;
-    bool bColumn = true;
-    int Corners = 0;
-
-    // Column = Value
-    QString Column;
-    QString Text;
-    Column.reserve( 4 );
-    Text.reserve( 32 );
-
-    char cur = nextChar();
-
-    // Process cell start with column (bColumn == true)
-    while ( cur != ')' && cur )
-    {
-        switch ( cur )
-        {
-        case '^':
-            // Oids
-            Corners++;
-            if ( 1 == Corners )
-            {
-                //bColumnOid = true;
-            }
-            else if ( 2 == Corners )
-            {
-                bColumn = false;
-                bValueOid = true;
-            }
-            else
-            {
-                Text += cur;
-            }
-
-            break;
-        case '=':
-            // From column to value
-            if ( bColumn )
-            {
-                bColumn = false;
-            }
-            else
-            {
-                Text += cur;
-            }
-            break;
-        case '\\':
-            {
-                // GY: logic changed
-                char NextChar= nextChar();
-                if ( '\r' != NextChar && '\n' != NextChar )
-                {
-                    Text += NextChar;
-                }
-                else {
-
-                    // Handle line termination with \r\n linefeed sequence
-                    NextChar = nextChar();
-
-                    // If its not \r\n or \n\r, revert back the next character
-                    if ( NextChar != '\r' && NextChar != '\n' )
-                        morkPos_--;
-                }
-            }
-            break;
-        case '$':
-            {
-                // Get next two chars
-                QString HexChar;
-                HexChar += nextChar();
-                HexChar += nextChar();
-                Text += ( char ) HexChar.toInt( 0, 16 );
-            }
-            break;
-        default:
-            // Just a char
-            if ( bColumn )
-            {
-                Column += cur;
-            }
-            else
-            {
-                Text += cur;
-            }
-            break;
-        }
+    bool hasText = false;
 
-        cur = nextChar();
-    }
+    readCell( &Column, &Text, &bValueOid, &hasText );
 
     // Apply column and text
-    int ColumnId = Column.toInt( 0, 16 );
-    if (parsedIds != nullptr) {
-        if (parsedIds->contains(ColumnId)) {
-            return;
-        }
-        parsedIds->append(ColumnId);
+    int ColumnId = literalToInt( Column );
+    // Only the first cell of a column counts
+    if (parsedIds != nullptr && !parsedIds->insert(ColumnId)) {
+        return;
+    }
+    if ( !hasText )
+    {
+        return;
     }
     if ( NPRows != nowParsing_ )
     {
         // Dicts
-        if ( "" != Text )
-        {
-            if ( nowParsing_ == NPColumns )
-            {
-                columns_[ ColumnId ] = Text;
-            }
-            else
+        handler_->onDictEntry( nowParsing_ == NPColumns ? ColumnDict : ValueDict, ColumnId, Text );
+    }
+    else
+    {
+        // Rows
+        handler_->onCell( ColumnId, Text, bValueOid );
+    }
+}
+
+//	=============================================================
+//	MorkReader::readCell
+
+void MorkReader::readCell( MorkLiteral * column, MorkLiteral * text, bool * valueOid, bool * hasText )
+{
+    // A cell is either (column=literal) or (column^oid), the column may be written as ^oid too.
+    if ( morkPos_ < morkEnd_ && morkData_[ morkPos_ ] == '^' )
+    {
+        morkPos_++;
+    }
+
+    // Process cell start with column
+    column->offset = morkPos_;
+    morkPos_ = qMin( structural_.next( morkPos_ ), morkEnd_ );
+
+    while ( morkPos_ < morkEnd_ && morkData_[ morkPos_ ] != '='
+            && morkData_[ morkPos_ ] != '^' && morkData_[ morkPos_ ] != ')' )
+    {
+        morkPos_ = qMin( structural_.next( morkPos_ + 1 ), morkEnd_ );
+    }
+
+    column->length = morkPos_ - column->offset;
+    *valueOid = false;
+
+    if ( morkPos_ < morkEnd_ && morkData_[ morkPos_ ] != ')' )
+    {
+        // From column to value
+        *valueOid = morkData_[ morkPos_ ] == '^';
+        morkPos_++;
+    }
+
+    *text = readLiteral( hasText );
+}
+
+//	=============================================================
+//	MorkReader::readLiteral
+
+MorkLiteral MorkReader::readLiteral( bool * hasText )
+{
+    MorkLiteral literal( morkPos_ );
+    *hasText = false;
+
+    while ( morkPos_ < morkEnd_ )
+    {
+        // Jump over the plain text to the next char which has a meaning in a literal
+        const int textEnd = qMin( structural_.nextInLiteral( morkPos_ ), morkEnd_ );
+
+        if ( textEnd > morkPos_ )
+        {
+            *hasText = true;
+            morkPos_ = textEnd;
+
+            if ( morkPos_ >= morkEnd_ )
+                break;
+        }
+
+        if ( morkData_[ morkPos_ ] == ')' )
+            break;
+
+        switch ( morkData_[ morkPos_ ] )
+        {
+        case '\\':
+            // The escaped char is skipped, so an escaped ')' doesn't end the literal.
+            // Escaped line breaks are line continuations and don't count as text.
+            literal.escaped = true;
+            morkPos_++;
+
+            if ( morkPos_ < morkEnd_ && morkData_[ morkPos_ ] != '\r' && morkData_[ morkPos_ ] != '\n' )
             {
-                values_[ ColumnId ] = Text;
+                *hasText = true;
             }
+
+            morkPos_++;
+            break;
+
+        case '$':
+            // Two hex chars follow
+            literal.escaped = true;
+            *hasText = true;
+            morkPos_ += 3;
+            break;
         }
     }
-    else
+
+    morkPos_ = qMin( morkPos_, morkEnd_ );
+    literal.length = morkPos_ - literal.offset;
+
+    // Skip the closing bracket
+    if ( morkPos_ < morkEnd_ )
+    {
+        morkPos_++;
+    }
+
+    return literal;
+}
+
+//	=============================================================
+//	MorkReader::decodeLiteral
+
+QByteArray MorkReader::decodeLiteral( const MorkLiteral &literal ) const
+{
+    const char * data = morkData_ + literal.offset;
+
+    if ( !literal.escaped )
+    {
+        return QByteArray( data, literal.length );
+    }
+
+    QByteArray out;
+    out.reserve( literal.length );
+
+    for ( int i = 0; i < literal.length; i++ )
     {
-        if (!Text.isEmpty()) {
-            // Rows
-            int ValueId = Text.toInt( 0, 16 );
+        switch ( data[ i ] )
+        {
+        case '\\':
+            if ( ++i >= literal.length )
+                break;
 
-            if ( bValueOid  )
+            if ( data[ i ] != '\r' && data[ i ] != '\n' )
             {
-                ( *currentCells_ )[ ColumnId ] = ValueId;
+                out += data[ i ];
             }
-            else
+            else if ( i + 1 < literal.length && ( data[ i + 1 ] == '\r' || data[ i + 1 ] == '\n' ) )
             {
-                nextAddValueId_--;
-                values_[ nextAddValueId_ ] = Text;
-                ( *currentCells_ )[ ColumnId ] = nextAddValueId_;
+                // Handle line termination with \r\n linefeed sequence
+                i++;
             }
+            break;
+
+        case '$':
+            out += static_cast<char>( hexToInt( data + i + 1, qMin( 2, literal.length - i - 1 ), nullptr ) );
+            i += 2;
+            break;
+
+        default:
+            out += data[ i ];
+            break;
         }
     }
+
+    return out;
+}
+
+//	=============================================================
+//	MorkReader::literalEquals
+
+bool MorkReader::literalEquals( const MorkLiteral &literal, const char * string ) const
+{
+    if ( literal.escaped )
+    {
+        return decodeLiteral( literal ) == string;
+    }
+
+    return static_cast<int>( strlen( string ) ) == literal.length
+            && memcmp( morkData_ + literal.offset, string, literal.length ) == 0;
+}
+
+//	=============================================================
+//	MorkReader::literalToInt
+
+int MorkReader::literalToInt( const MorkLiteral &literal ) const
+{
+    bool ok = false;
+    return literalToNumber( literal, &ok );
+}
+
+//	=============================================================
+//	MorkReader::literalToNumber
+
+int MorkReader::literalToNumber( const MorkLiteral &literal, bool *ok ) const
+{
+    if ( literal.escaped )
+    {
+        const QByteArray decoded = decodeLiteral( literal );
+        return hexToInt( decoded.constData(), decoded.size(), ok );
+    }
+
+    return hexToInt( morkData_ + literal.offset, literal.length, ok );
+}
+
+//	=============================================================
+//	MorkReader::literalToAtom
+
+int MorkReader::literalToAtom( const MorkLiteral &literal ) const
+{
+    if ( literal.escaped )
+    {
+        return MorkAtomTable::intern( decodeLiteral( literal ) );
+    }
+
+    return MorkAtomTable::intern( morkData_ + literal.offset, literal.length );
+}
+
+//	=============================================================
+//	MorkReader::setStructuralImplementation
+
+void MorkReader::setStructuralImplementation( MorkStructuralIndex::Implementation implementation )
+{
+    structuralImplementation_ = implementation;
 }
 
 //	=============================================================
-//	MorkParser::parseTable
+//	MorkReader::parseTable
 
-void MorkParser::parseTable()
+void MorkReader::parseTable()
 {
-    QString TextId;
+    MorkLiteral TextId( morkPos_ );
     int Id = 0, Scope = 0;
 
     char cur = nextChar();
@@ -468,16 +954,17 @@ void MorkParser::parseTable()
     // Get id
     while ( cur != '{' && cur != '[' && cur != '}' && cur )
     {
-        if ( !isWhiteSpace( cur ) )
-        {
-            TextId += cur;
-        }
-
         cur = nextChar();
     }
 
+    TextId.length = ( cur ? morkPos_ - 1 : morkPos_ ) - TextId.offset;
     parseScopeId( TextId, &Id, &Scope );
 
+    // The ids are reported as positive numbers, with the default scope if there is none
+    Id = abs( Id );
+    Scope = Scope ? abs( Scope ) : defaultScope_;
+    handler_->onTableBegin( Scope, Id );
+
     // Parse the table
     while ( cur != '}' && cur )
     {
@@ -499,21 +986,23 @@ void MorkParser::parseTable()
 
             default:
                 {
-                    QString JustId;
+                    MorkLiteral JustId( morkPos_ - 1 );
                     while ( !isWhiteSpace( cur ) && cur )
                     {
-                        JustId += cur;
+                        JustId.length++;
                         cur = nextChar();
 
                         if ( cur == '}' )
                         {
+                            handler_->onTableEnd();
                             return;
                         }
                     }
 
                     int JustIdNum = 0, JustScopeNum = 0;
                     parseScopeId( JustId, &JustIdNum, &JustScopeNum );
-                    setCurrentRow( Scope, Id, JustScopeNum, JustIdNum );
+                    handler_->onRowReference( Id ? Scope : 0, Id,
+                            JustScopeNum ? abs( JustScopeNum ) : defaultScope_, abs( JustIdNum ) );
                 }
                 break;
             }
@@ -521,90 +1010,85 @@ void MorkParser::parseTable()
 
         cur = nextChar();
     }
+
+    handler_->onTableEnd();
 }
 
 //	=============================================================
-//	MorkParser::parseScopeId
+//	MorkReader::parseScopeId
 
-void MorkParser::parseScopeId(const QString &TextId, int *Id, int *Scope )
+void MorkReader::parseScopeId( const MorkLiteral &TextId, int *Id, int *Scope )
 {
-    int Pos = 0;
+    const char * data = morkData_ + TextId.offset;
+    const char * separator = static_cast<const char *>( memchr( data, ':', TextId.length ) );
 
-    if ( ( Pos = TextId.indexOf( ':' ) ) >= 0 )
+    if ( separator )
     {
-        QString tId = TextId.mid( 0, Pos );
-        QString tSc = TextId.mid( Pos + 1, TextId.length() - Pos );
+        const char * scope = separator + 1;
+        int scopeLength = TextId.length - static_cast<int>( scope - data );
+
+        while ( scopeLength > 0 && isWhiteSpace( *scope ) )
+        {
+            scope++;
+            scopeLength--;
+        }
 
-        if ( tSc.length() > 1 && '^' == tSc[ 0 ] )
+        if ( scopeLength > 1 && '^' == scope[ 0 ] )
         {
-            // Delete '^'
-            tSc.remove( 0, 1 );
+            // Skip '^'
+            scope++;
+            scopeLength--;
         }
 
-        *Id = tId.toInt( 0, 16 );
-        *Scope = tSc.toInt( 0, 16 );
+        *Id = hexToInt( data, static_cast<int>( separator - data ), nullptr );
+        *Scope = hexToInt( scope, scopeLength, nullptr );
     }
     else
     {
-        *Id = TextId.toInt( 0, 16 );
+        *Id = hexToInt( data, TextId.length, nullptr );
     }
 }
 
 //	=============================================================
-//	MorkParser::setCurrentRow
+//	MorkReader::readRowId
 
-inline void MorkParser::setCurrentRow( int TableScope, int TableId, int RowScope, int RowId )
+char MorkReader::readRowId( int *Id, int *Scope )
 {
-    if ( !RowScope )
-    {
-        RowScope = defaultScope_;
-    }
-    
-    if (!TableId) {
-        QPair<int, int> rowMapping = rowMappings.value(abs(RowId)).value(RowScope, {0, 0});
-        TableScope = rowMapping.first;
-        TableId = rowMapping.second;
-    }
+    MorkLiteral TextId( morkPos_ );
+    char cur = nextChar();
 
-    if ( !TableScope )
+    // Get id
+    while ( cur != '(' && cur != ']' && cur != '[' && cur )
     {
-        TableScope = defaultScope_;
+        cur = nextChar();
     }
 
-    currentCells_ = &( mork_[ abs( TableScope ) ][ abs( TableId ) ][ abs( RowScope ) ][ abs( RowId ) ] );
+    TextId.length = ( cur ? morkPos_ - 1 : morkPos_ ) - TextId.offset;
+    parseScopeId( TextId, Id, Scope );
+    return cur;
 }
 
 //	=============================================================
-//	MorkParser::parseRow
+//	MorkReader::parseRow
 
-void MorkParser::parseRow( int TableId, int TableScope )
+void MorkReader::parseRow( int TableId, int TableScope )
 {
-    QString TextId;
     int Id = 0, Scope = TableScope;
     nowParsing_ = NPRows;
 
-    char cur = nextChar();
-
-    // Get id
-    while ( cur != '(' && cur != ']' && cur != '[' && cur )
-    {
-        if ( !isWhiteSpace( cur ) )
-        {
-            TextId += cur;
-        }
-
-        cur = nextChar();
-    }
-
-    parseScopeId( TextId, &Id, &Scope );
+    // The row scope defaults to the scope of the table. Rows outside of a table
+    // are reported without a table scope.
+    char cur = readRowId( &Id, &Scope );
     bool cutMode = Id < 0;
-    setCurrentRow( TableScope, TableId, Scope, Id );
+    bool readCells = handler_->onRowBegin( TableId ? TableScope : 0, TableId,
+                                           Scope ? abs( Scope ) : defaultScope_, abs( Id ) );
     if (cutMode) {
-        (*currentCells_).clear();
+        handler_->onRowCut();
     }
     
-    QList<int> parsedCellIds;
-    // Parse the row
+    parsedCellIds_.clear();
+    bool hasText = false;
+    // Parse the row, skipping over the cells if the handler doesn't want them
     while ( cur != ']' && cur )
     {
         if ( !isWhiteSpace( cur ) )
@@ -612,7 +1096,10 @@ void MorkParser::parseRow( int TableId, int TableScope )
             switch ( cur )
             {
             case '(':
-                parseCell(&parsedCellIds);
+                if ( readCells )
+                    parseCell(&parsedCellIds_);
+                else
+                    readLiteral( &hasText );
                 break;
             case '[':
                 parseMeta( ']' );
@@ -625,80 +1112,269 @@ void MorkParser::parseRow( int TableId, int TableScope )
 
         cur = nextChar();
     }
-    if (TableId != 0) {
-        rowMappings[abs(Id)][Scope == 0 ? defaultScope_ : Scope] = {TableScope, TableId};
-    }
+
+    handler_->onRowEnd();
 }
 
 //	=============================================================
-//	MorkParser::parseGroup
+//	MorkReader::parseGroup
 
-void MorkParser::parseGroup()
+void MorkReader::parseGroup()
 {
     // See https://developer.mozilla.org/en-US/docs/Mozilla/Tech/Mork/Structure
     // In version 1.4, @ is always followed by $$ as part of the group markup syntax
     skip( "$${" );
 
     // Group ID
-    QString id = readHexNumber();
+    MorkLiteral id = readHexNumber();
 
     // Skip transaction start
     skip( "{@" );
 
-    // From here we have the whole transaction. Find out the transaction end
-    QString endCommit = "@$$}" + id + "}@";
-    QString endAbort = "@$$}~abort~" + id + "}@";
+    // From here we have the whole transaction. Find out the transaction end with a single
+    // forward scan, the first end marker of this group ends it, be it a commit or an abort.
+    int markerLength = 0;
+    bool aborted = false;
+    int ofst = findGroupEnd( id, &markerLength, &aborted );
 
-    // Find the end of this group
-    int ofst = morkData_.indexOf( endAbort, morkPos_ );
+    if (ofst == -1) {
+        throw MorkParserException(QCoreApplication::translate(
+                "MorkParser", "Unexpected end of group."));
+    }
 
-    if ( ofst != -1 )
+    if ( !aborted )
     {
-        // Transaction aborted (does this ever happen?)
-        morkPos_ = ofst + endAbort.length();
-        return;
+        parseGroupContent( ofst );
     }
 
-    // Now look up for success
-    ofst = morkData_.indexOf( endCommit, morkPos_ );
+    morkPos_ = ofst + markerLength;
+}
 
-    if (ofst == -1) {
-        throw MorkParserException(QCoreApplication::translate(
-                "MorkParser", "Unexpected end of group."));
-    }
-    // Transaction succeeded. Copy the transaction data
-    QByteArray transaction = morkData_.mid( morkPos_, ofst - morkPos_ );
+//	=============================================================
+//	MorkReader::parseGroupContent
+
+void MorkReader::parseGroupContent( int end )
+{
+    // Parse the transaction data in place, the literals keep pointing into the mork data.
+    // We reuse the parse() routine, which stops at the end of the transaction.
+    handler_->onGroupBegin();
 
-    // Now we want to reuse the parse() routine, so we store the old data
-    if ( !transaction.trimmed().isEmpty() )
+    int oldEnd = morkEnd_;
+    morkEnd_ = end;
+
+    parse();
+
+    // And restore the old end back
+    morkEnd_ = oldEnd;
+
+    handler_->onGroupCommit();
+}
+
+//	=============================================================
+//	MorkReader::findGroupEnd
+
+int MorkReader::findGroupEnd( const MorkLiteral &id, int *markerLength, bool *aborted )
+{
+    static const char GroupEnd[] = "@$$}";
+    static const char GroupAbort[] = "~abort~";
+    const int groupEndLength = static_cast<int>( strlen( GroupEnd ) );
+    const int groupAbortLength = static_cast<int>( strlen( GroupAbort ) );
+
+    // Single forward scan for the first end marker of this group, be it a commit or an abort
+    for ( int pos = morkPos_; pos < morkEnd_; pos++ )
     {
-        QByteArray oldmork = morkData_;
+        const char * found = static_cast<const char *>( memchr( morkData_ + pos, '@', morkEnd_ - pos ) );
+
+        if ( !found )
+            break;
 
-        // and replace it with transaction
-        morkData_ = transaction;
-        morkPos_ = 0;
+        pos = static_cast<int>( found - morkData_ );
 
-        // Parse it
-        parse();
+        if ( !matchesAt( pos, GroupEnd, groupEndLength ) )
+            continue;
 
-        // And restore the old values back
-        morkData_ = oldmork;
+        int idPos = pos + groupEndLength;
+        *aborted = matchesAt( idPos, GroupAbort, groupAbortLength );
+
+        if ( *aborted )
+            idPos += groupAbortLength;
+
+        if ( matchesAt( idPos, morkData_ + id.offset, id.length ) && matchesAt( idPos + id.length, "}@", 2 ) )
+        {
+            *markerLength = idPos + id.length + 2 - pos;
+            groupEndScanLength_ += pos + *markerLength - morkPos_;
+            return pos;
+        }
     }
 
-    morkPos_ = ofst + endCommit.length();
+    groupEndScanLength_ += morkEnd_ - morkPos_;
+    return -1;
 }
 
 //	=============================================================
-//	MorkParser::parseMeta
+//	MorkReader::matchesAt
 
-void MorkParser::parseMeta( char c )
+bool MorkReader::matchesAt( int offset, const char * string, int length ) const
 {
-    char cur = nextChar();
+    return offset >= 0 && morkEnd_ - offset >= length && memcmp( morkData_ + offset, string, length ) == 0;
+}
+
+//	=============================================================
+//	MorkReader::parseMeta
+
+void MorkReader::parseMeta( char c )
+{
+    // The meta ends with a structural char
+    char cur = nextStructuralChar();
 
     while ( cur != c && cur )
     {
-        cur = nextChar();
+        cur = nextStructuralChar();
+    }
+}
+
+//	=============================================================
+//	MorkParser::MorkParser
+
+MorkParser::MorkParser( int DefaultScope )
+    : MorkReader( this, DefaultScope )
+{
+    initVars();
+}
+
+//	=============================================================
+//	MorkParser::initVars
+
+void MorkParser::initVars()
+{
+    MorkReader::initVars();
+    currentRow_ = -1;
+    currentRowIsEmpty_ = false;
+    nextAddValueId_ = 0x7fffffff;
+}
+
+//	=============================================================
+//	MorkParser::closeData
+
+void MorkParser::closeData()
+{
+    // The dicts and cells refer to the data, so they go together with it
+    columns_.clear();
+    values_.clear();
+    rows_.clear();
+    tables_.clear();
+    rowMappings.clear();
+
+    MorkReader::closeData();
+}
+
+//	=============================================================
+//	MorkParser::setCurrentRow
+
+void MorkParser::setCurrentRow( int TableScope, int TableId, int RowScope, int RowId )
+{
+    if (!TableId) {
+        QPair<int, int> rowMapping = rowMappings.value(rowMappingKey(RowScope, RowId), {0, 0});
+        TableScope = rowMapping.first;
+        TableId = rowMapping.second;
+    }
+
+    if ( !TableScope )
+    {
+        TableScope = defaultScope_;
+    }
+
+    currentRow_ = rows_.insertRow( TableScope, TableId, RowScope, RowId );
+    currentRowIsEmpty_ = rows_.row( currentRow_ ).cellCount == 0;
+}
+
+//	=============================================================
+//	MorkParser::onDictEntry
+
+void MorkParser::onDictEntry( MorkDictType dict, int id, const MorkLiteral &value )
+{
+    if ( dict == ColumnDict )
+    {
+        columns_.insert( id, literalToAtom( value ) );
+    }
+    else
+    {
+        values_.insert( id, value );
+    }
+}
+
+//	=============================================================
+//	MorkParser::onRowBegin
+
+bool MorkParser::onRowBegin( int tableScope, int tableId, int rowScope, int rowId )
+{
+    setCurrentRow( tableScope, tableId, rowScope, rowId );
+
+    // Rows outside of a table are mapped to the table they were first seen in
+    if (tableId != 0) {
+        rowMappings.insert(rowMappingKey(rowScope, rowId), {tableScope, tableId});
+    }
+    return true;
+}
+
+//	=============================================================
+//	MorkParser::onRowCut
+
+void MorkParser::onRowCut()
+{
+    rows_.clearCells( currentRow_ );
+    currentRowIsEmpty_ = true;
+}
+
+//	=============================================================
+//	MorkParser::onCell
+
+void MorkParser::onCell( int column, const MorkLiteral &value, bool valueOid )
+{
+    int valueId;
+
+    if ( valueOid )
+    {
+        valueId = literalToInt( value );
+    }
+    else
+    {
+        nextAddValueId_--;
+        values_.insert( nextAddValueId_, value );
+        valueId = nextAddValueId_;
+    }
+
+    if ( currentRowIsEmpty_ )
+        rows_.appendCell( currentRow_, column, valueId );
+    else
+        rows_.setCell( currentRow_, column, valueId );
+}
+
+//	=============================================================
+//	MorkParser::onRowReference
+
+void MorkParser::onRowReference( int tableScope, int tableId, int rowScope, int rowId )
+{
+    setCurrentRow( tableScope, tableId, rowScope, rowId );
+}
+
+//	=============================================================
+//	MorkParser::getTableScopes
+
+QList<int> MorkParser::getTableScopes() const
+{
+    QList<int> tableScopes;
+
+    for ( int i = 0; i < rows_.rowCount(); i++ )
+    {
+        const int tableScope = rows_.row( i ).tableScope;
+
+        if ( !tableScopes.contains( tableScope ) )
+            tableScopes.append( tableScope );
     }
+
+    std::sort( tableScopes.begin(), tableScopes.end() );
+    return tableScopes;
 }
 
 //	=============================================================
@@ -707,11 +1383,35 @@ void MorkParser::parseMeta( char c )
 MorkTableMap *MorkParser::getTables( int TableScope )
 {
     TableScopeMap::iterator iter;
-    iter = mork_.find( TableScope );
+    iter = tables_.find( TableScope );
 
-    if ( iter == mork_.end() )
+    if ( iter == tables_.end() )
     {
-        return 0;
+        // Build the maps of this table scope from the row storage
+        MorkTableMap tables;
+
+        for ( int i = 0; i < rows_.rowCount(); i++ )
+        {
+            const MorkRow &row = rows_.row( i );
+
+            if ( row.tableScope != TableScope )
+                continue;
+
+            MorkCells &cells = tables[ row.tableId ][ row.rowScope ][ row.rowId ];
+            const MorkCell * cell = rows_.cells( i );
+
+            for ( int c = 0; c < row.cellCount; c++ )
+            {
+                cells.insert( cell[ c ].column, cell[ c ].value );
+            }
+        }
+
+        if ( tables.isEmpty() )
+        {
+            return 0;
+        }
+
+        iter = tables_.insert( TableScope, tables );
     }
 
     return &iter.value();
@@ -736,19 +1436,34 @@ MorkRowMap *MorkParser::getRows( int RowScope, RowScopeMap *table )
 const MorkRowMap * MorkParser::rows(int tablescope, int tableid, int rowscope )
 {
     // Find the tables for this table scope
-    if ( !mork_.contains( tablescope ) )
+    MorkTableMap * tables = getTables( tablescope );
+
+    if ( !tables )
         return 0;
 
     // Find the table
-    if ( !mork_[ tablescope ].contains( tableid ) )
+    MorkTableMap::iterator table = tables->find( tableid );
+
+    if ( table == tables->end() )
         return 0;
 
     // Find the row scope
-    if ( !mork_[ tablescope ][ tableid ].contains( rowscope ) )
+    RowScopeMap::iterator rows = table->find( rowscope );
+
+    if ( rows == table->end() )
         return 0;
 
     // We got it
-    return &mork_[ tablescope ][ tableid ][rowscope];
+    return &rows.value();
+}
+
+//	=============================================================
+//	MorkParser::reset
+
+void MorkParser::reset()
+{
+    closeData();
+    initVars();
 }
 
 //	=============================================================
@@ -756,14 +1471,14 @@ const MorkRowMap * MorkParser::rows(int tablescope, int tableid, int rowscope )
 
 QString MorkParser::getValue( int oid )
 {
-    MorkDict::iterator foundIter = values_.find( oid );
+    const MorkLiteral * found = values_.find( oid );
 
-    if ( values_.end() == foundIter )
+    if ( !found )
     {
         return QString();
     }
 
-    return *foundIter;
+    return QString::fromUtf8( decodeLiteral( *found ) );
 }
 
 //	=============================================================
@@ -771,14 +1486,42 @@ QString MorkParser::getValue( int oid )
 
 QString MorkParser::getColumn( int oid )
 {
-    MorkDict::iterator foundIter = columns_.find( oid );
+    const int * found = columns_.find( oid );
 
-    if ( columns_.end() == foundIter )
+    if ( !found )
     {
         return QString();
     }
 
-    return *foundIter;
+    return QString::fromUtf8( MorkAtomTable::name( *found ) );
+}
+
+//	=============================================================
+//	MorkParser::findColumn
+
+int MorkParser::findColumn( const char * name )
+{
+    const int atom = MorkAtomTable::find( QByteArray::fromRawData( name, static_cast<int>( strlen( name ) ) ) );
+
+    if ( !atom )
+    {
+        return 0;
+    }
+
+    // The lowest column id wins if a name is defined more than once
+    int column = 0;
+
+    for ( int i = 0; i < columns_.size(); i++ )
+    {
+        const MorkIdMap< int >::Entry &entry = columns_.entry( i );
+
+        if ( entry.value == atom && ( !column || entry.id < column ) )
+        {
+            column = entry.id;
+        }
+    }
+
+    return column;
 }
 
 int MorkParser::dumpMorkFile( const QString& filename )
@@ -788,10 +1531,10 @@ int MorkParser::dumpMorkFile( const QString& filename )
     if ( !p.open( filename ) )
         qFatal( "Error opening mork file." );
 
-    for ( TableScopeMap::iterator tit = p.mork_.begin(); tit != p.mork_.end(); ++tit )
+    for ( int tableScope : p.getTableScopes() )
     {
-        printf("Table scope %02X (%s)\n", tit.key(), qPrintable(p.getColumn(tit.key())) );
-        const MorkTableMap& map = tit.value();
+        printf("Table scope %02X (%s)\n", tableScope, qPrintable(p.getColumn(tableScope)) );
+        const MorkTableMap& map = *p.getTables( tableScope );
 
         for ( MorkTableMap::const_iterator mit = map.begin(); mit != map.end(); ++mit )
         {
@@ -827,24 +1570,24 @@ int MorkParser::dumpMorkFile( const QString& filename )
 }
 
 unsigned int MailMorkParser::getNumUnreadMessages() {
-    const int scopeId = this->columns_.key(MorkDbFolderInfoScope);
+    const int scopeId = findColumn(MorkDbFolderInfoScope);
     if (!scopeId) {
-        Log::debug("Mork table %s not found", MorkDbFolderInfoScope);
+        LOG_WARNING("Mork table %s not found", MorkDbFolderInfoScope);
         return 0;
     }
+    static const int numNewMsgsAtom = MorkAtomTable::intern("numNewMsgs");
     const MorkRowMap* rows = this->rows(scopeId, 1, scopeId);
     if (rows) {
         for (MorkRowMap::const_iterator rit = rows->begin(); rit != rows->cend(); rit++) {
             MorkCells cells = rit.value();
             for (int colId : cells.keys()) {
-                QString columnName = getColumn(colId);
-                if (columnName == "numNewMsgs") {
+                if (columns_.value(colId) == numNewMsgsAtom) {
                     bool correct;
-                    unsigned int value = getValue(cells[colId]).toInt(&correct, 16);
+                    unsigned int value = literalToNumber(values_.value(cells[colId]), &correct);
                     if (correct) {
                         return static_cast<int>(value);
                     } else {
-                        Log::debug("Incorrect Mork value: %s",
+                        LOG_WARNING("Incorrect Mork value: %s",
                                 qPrintable(getValue(cells[colId])));
                     }
                 }
@@ -853,3 +1596,426 @@ unsigned int MailMorkParser::getNumUnreadMessages() {
     }
     return 0;
 }
+
+//	=============================================================
+//	MorkUnreadScanner
+
+MorkUnreadScanner::MorkUnreadScanner()
+    : MorkReader( this )
+{
+    initVars();
+}
+
+void MorkUnreadScanner::initVars()
+{
+    MorkReader::initVars();
+    folderInfoScope_ = 0;
+    numNewMsgsColumn_ = 0;
+    numberValues_.clear();
+    folderInfoRowMappings_.clear();
+    folderInfoRows_.clear();
+    currentFolderInfoRow_ = nullptr;
+    fileIdentity_ = 0;
+    scannedSize_ = 0;
+    scannedTail_.clear();
+    scannedModified_ = 0;
+    scannedPrefixHash_.clear();
+    scannedPrefixLength_ = 0;
+}
+
+bool MorkUnreadScanner::update( const QString &path )
+{
+    const quint64 identity = getFileIdentity( path );
+
+    // Taken before parsing, so a change during the parse makes a checkpoint outdated
+    const qint64 modified = QFileInfo( path ).lastModified().toMSecsSinceEpoch();
+
+    if ( scannedSize_ > 0 && identity == fileIdentity_ && path == morkFile_.fileName() )
+    {
+        bool parsed = false;
+
+        try {
+            parsed = parseTail();
+        } catch (MorkParserException &error) {
+            LOG_DEBUG("Unable to parse the appended part of %s: %s",
+                      qPrintable( path ), qPrintable( error.getMessage() ));
+        }
+
+        if ( parsed )
+        {
+            scannedModified_ = modified;
+            closeData();
+            return true;
+        }
+    }
+
+    // Parse the whole file. Our state doesn't refer to the data, so we don't need to keep it.
+    bool success = open( path );
+
+    if ( success )
+    {
+        fileIdentity_ = identity;
+        scannedModified_ = modified;
+        setScanned( 0, morkEnd_ );
+        scannedPrefixLength_ = qMin( morkEnd_, CheckpointPrefixSize );
+        scannedPrefixHash_ = QCryptographicHash::hash(
+                QByteArray::fromRawData( morkData_, scannedPrefixLength_ ), QCryptographicHash::Sha1 );
+    }
+
+    closeData();
+    return success;
+}
+
+bool MorkUnreadScanner::parseTail()
+{
+    static const char MorkHeaderStart[] = "// <!-- <mdb:mork";
+
+    if ( !morkFile_.open( QIODevice::ReadOnly ) )
+        return false;
+
+    // A shrunken file was rewritten
+    const qint64 size = morkFile_.size();
+
+    if ( size < scannedSize_ )
+        return false;
+
+    // Load the new data together with the end of the already parsed data,
+    // which must not have changed if the file was only appended to.
+    const qint64 dataOffset = scannedSize_ - scannedTail_.size();
+    loadData( dataOffset, size - dataOffset );
+
+    if ( !matchesAt( 0, scannedTail_.constData(), scannedTail_.size() ) )
+        return false;
+
+    morkPos_ = scannedTail_.size();
+
+    // A new header means the file was rewritten from the start
+    if ( QByteArray::fromRawData( morkData_ + morkPos_, morkEnd_ - morkPos_ ).contains( MorkHeaderStart ) )
+        return false;
+
+    // Betterbird appends its changes as groups. Parse all complete groups
+    // and leave a group which is still being written for the next update.
+    int parsedEnd = morkPos_;
+    char cur = nextChar();
+
+    while ( cur )
+    {
+        if ( !isWhiteSpace( cur ) )
+        {
+            if ( cur != '@' || !matchesAt( morkPos_, "$${", 3 ) )
+                return false;
+
+            const int groupStart = morkPos_ - 1;
+            int idEnd = morkPos_ + 3;
+
+            while ( idEnd < morkEnd_ && isalnum( static_cast<unsigned char>( morkData_[ idEnd ] ) ) )
+                idEnd++;
+
+            if ( !matchesAt( idEnd, "{@", 2 ) )
+            {
+                // Either the group header was cut off, or this is not a group
+                if ( morkEnd_ - idEnd >= 2 )
+                    return false;
+
+                break;
+            }
+
+            const MorkLiteral id( morkPos_ + 3, idEnd - morkPos_ - 3 );
+            morkPos_ = idEnd + 2;
+
+            int markerLength = 0;
+            bool aborted = false;
+            int ofst = findGroupEnd( id, &markerLength, &aborted );
+
+            if ( ofst == -1 )
+            {
+                morkPos_ = groupStart;
+                break;
+            }
+
+            if ( !aborted )
+            {
+                parseGroupContent( ofst );
+            }
+
+            morkPos_ = ofst + markerLength;
+            parsedEnd = morkPos_;
+        }
+
+        cur = nextChar();
+    }
+
+    setScanned( dataOffset, parsedEnd );
+    return true;
+}
+
+void MorkUnreadScanner::setScanned( qint64 dataOffset, int dataEnd )
+{
+    // The end of the parsed data must still be the same on the next update
+    const int tailLength = qMin( dataEnd, 64 );
+    scannedSize_ = dataOffset + dataEnd;
+    scannedTail_ = QByteArray( morkData_ + dataEnd - tailLength, tailLength );
+}
+
+QByteArray MorkUnreadScanner::saveCheckpoint() const
+{
+    if ( scannedSize_ <= 0 )
+        return QByteArray();
+
+    QByteArray checkpoint;
+    QDataStream out( &checkpoint, QIODevice::WriteOnly );
+    out.setVersion( QDataStream::Qt_5_6 );
+    out << CheckpointVersion << morkFile_.fileName() << fileIdentity_ << scannedSize_ << scannedModified_
+        << static_cast<qint32>( scannedPrefixLength_ ) << scannedPrefixHash_ << scannedTail_
+        << static_cast<qint32>( folderInfoScope_ ) << static_cast<qint32>( numNewMsgsColumn_ )
+        << numberValues_ << folderInfoRowMappings_ << static_cast<qint32>( folderInfoRows_.size() );
+
+    for ( QMap< int, FolderInfoCells >::const_iterator rit = folderInfoRows_.cbegin(); rit != folderInfoRows_.cend(); ++rit )
+    {
+        out << static_cast<qint32>( rit.key() ) << static_cast<qint32>( rit.value().size() );
+
+        for ( FolderInfoCells::const_iterator cell = rit.value().cbegin(); cell != rit.value().cend(); ++cell )
+            out << static_cast<qint32>( cell.key() ) << cell->isOid << cell->isNumber << static_cast<qint32>( cell->value );
+    }
+
+    return checkpoint;
+}
+
+bool MorkUnreadScanner::restoreCheckpoint( const QString &path, const QByteArray &checkpoint )
+{
+    closeData();
+    initVars();
+
+    if ( checkpoint.isEmpty() )
+        return false;
+
+    QDataStream in( checkpoint );
+    in.setVersion( QDataStream::Qt_5_6 );
+    quint32 version = 0;
+    in >> version;
+
+    if ( version != CheckpointVersion )
+    {
+        LOG_DEBUG("Ignoring the checkpoint of %s with version %u", qPrintable( path ), version);
+        return false;
+    }
+
+    QString checkpointPath;
+    qint32 prefixLength = 0, folderInfoScope = 0, numNewMsgsColumn = 0, rowCount = 0;
+    in >> checkpointPath >> fileIdentity_ >> scannedSize_ >> scannedModified_ >> prefixLength
+       >> scannedPrefixHash_ >> scannedTail_ >> folderInfoScope >> numNewMsgsColumn
+       >> numberValues_ >> folderInfoRowMappings_ >> rowCount;
+
+    for ( qint32 row = 0; row < rowCount && in.status() == QDataStream::Ok; row++ )
+    {
+        qint32 rowId = 0, cellCount = 0;
+        in >> rowId >> cellCount;
+        FolderInfoCells &cells = folderInfoRows_[ rowId ];
+
+        for ( qint32 i = 0; i < cellCount && in.status() == QDataStream::Ok; i++ )
+        {
+            qint32 column = 0, value = 0;
+            FolderInfoCell cell;
+            in >> column >> cell.isOid >> cell.isNumber >> value;
+            cell.value = value;
+            cells[ column ] = cell;
+        }
+    }
+
+    scannedPrefixLength_ = prefixLength;
+    folderInfoScope_ = folderInfoScope;
+    numNewMsgsColumn_ = numNewMsgsColumn;
+
+    if ( in.status() != QDataStream::Ok || !in.atEnd() || checkpointPath != path
+         || !isScannedPartUnchanged( path ) )
+    {
+        LOG_DEBUG("The checkpoint of %s is outdated", qPrintable( path ));
+        initVars();
+        return false;
+    }
+
+    // The next update continues at the end of the parsed part
+    morkFile_.setFileName( path );
+    return true;
+}
+
+bool MorkUnreadScanner::isScannedPartUnchanged( const QString &path ) const
+{
+    if ( scannedSize_ <= 0 || scannedPrefixLength_ < 0 || scannedPrefixLength_ > scannedSize_
+         || getFileIdentity( path ) != fileIdentity_ )
+        return false;
+
+    QFile file( path );
+
+    if ( !file.open( QIODevice::ReadOnly ) || file.size() < scannedSize_ )
+        return false;
+
+    // A file which was modified without growing has been rewritten in place
+    if ( file.size() == scannedSize_ && QFileInfo( file ).lastModified().toMSecsSinceEpoch() != scannedModified_ )
+        return false;
+
+    // The end of the parsed part is checked by parseTail
+    return QCryptographicHash::hash( file.read( scannedPrefixLength_ ), QCryptographicHash::Sha1 ) == scannedPrefixHash_;
+}
+
+bool MorkUnreadScanner::setCurrentRow( int TableScope, int TableId, int RowScope, int RowId )
+{
+    // Only the rows of the dbfolderinfo row scope can be in the dbfolderinfo table
+    if ( !folderInfoScope_ || RowScope != folderInfoScope_ )
+    {
+        currentFolderInfoRow_ = nullptr;
+        return false;
+    }
+
+    if ( !TableId )
+    {
+        QPair<int, int> rowMapping = folderInfoRowMappings_.value( RowId, {0, 0} );
+        TableScope = rowMapping.first;
+        TableId = rowMapping.second;
+    }
+
+    if ( !TableScope )
+    {
+        TableScope = defaultScope_;
+    }
+
+    if ( TableScope == folderInfoScope_ && TableId == 1 )
+    {
+        currentFolderInfoRow_ = &folderInfoRows_[ RowId ];
+    }
+    else
+    {
+        currentFolderInfoRow_ = nullptr;
+    }
+
+    return currentFolderInfoRow_ != nullptr;
+}
+
+bool MorkUnreadScanner::onRowBegin( int tableScope, int tableId, int rowScope, int rowId )
+{
+    // Rows outside of a table are mapped to the table they were first seen in
+    if ( tableId != 0 && folderInfoScope_ && rowScope == folderInfoScope_ )
+    {
+        folderInfoRowMappings_[ rowId ] = {tableScope, tableId};
+    }
+
+    // The cells of all rows but the dbfolderinfo rows are skipped over
+    return setCurrentRow( tableScope, tableId, rowScope, rowId );
+}
+
+void MorkUnreadScanner::onRowCut()
+{
+    if ( currentFolderInfoRow_ )
+    {
+        currentFolderInfoRow_->clear();
+    }
+}
+
+void MorkUnreadScanner::onRowReference( int tableScope, int tableId, int rowScope, int rowId )
+{
+    setCurrentRow( tableScope, tableId, rowScope, rowId );
+}
+
+void MorkUnreadScanner::onCell( int column, const MorkLiteral &value, bool valueOid )
+{
+    if ( !currentFolderInfoRow_ )
+        return;
+
+    FolderInfoCell cell;
+    cell.isOid = valueOid;
+    cell.isNumber = true;
+
+    if ( valueOid )
+    {
+        cell.value = literalToInt( value );
+    }
+    else
+    {
+        cell.value = literalToNumber( value, &cell.isNumber );
+    }
+
+    ( *currentFolderInfoRow_ )[ column ] = cell;
+}
+
+void MorkUnreadScanner::onDictEntry( MorkDictType dict, int id, const MorkLiteral &value )
+{
+    if ( dict == ColumnDict )
+    {
+        static const int folderInfoScopeAtom = MorkAtomTable::intern( MorkDbFolderInfoScope );
+        static const int numNewMsgsAtom = MorkAtomTable::intern( "numNewMsgs" );
+        const int atom = literalToAtom( value );
+
+        // Only remember the columns we are looking for. Like the full parser,
+        // prefer the lowest column id if a name is defined more than once.
+        if ( atom == folderInfoScopeAtom )
+        {
+            if ( !folderInfoScope_ || id < folderInfoScope_ )
+                folderInfoScope_ = id;
+        }
+        else if ( id == folderInfoScope_ )
+        {
+            folderInfoScope_ = 0;
+        }
+
+        if ( atom == numNewMsgsAtom )
+        {
+            if ( !numNewMsgsColumn_ || id < numNewMsgsColumn_ )
+                numNewMsgsColumn_ = id;
+        }
+        else if ( id == numNewMsgsColumn_ )
+        {
+            numNewMsgsColumn_ = 0;
+        }
+    }
+    else
+    {
+        // Only numbers can be referenced as the number of unread emails
+        bool isNumber = false;
+        int number = literalToNumber( value, &isNumber );
+
+        if ( isNumber )
+            numberValues_[ id ] = number;
+        else
+            numberValues_.remove( id );
+    }
+}
+
+unsigned int MorkUnreadScanner::getNumUnreadMessages() const
+{
+    if ( !folderInfoScope_ )
+    {
+        LOG_WARNING("Mork table %s not found", MorkDbFolderInfoScope);
+        return 0;
+    }
+
+    if ( !numNewMsgsColumn_ )
+        return 0;
+
+    for ( QMap< int, FolderInfoCells >::const_iterator rit = folderInfoRows_.cbegin(); rit != folderInfoRows_.cend(); ++rit )
+    {
+        FolderInfoCells::const_iterator cell = rit.value().find( numNewMsgsColumn_ );
+
+        if ( cell == rit.value().cend() )
+            continue;
+
+        if ( cell->isOid )
+        {
+            QHash< int, int >::const_iterator value = numberValues_.find( cell->value );
+
+            if ( value != numberValues_.cend() )
+                return static_cast<unsigned int>( value.value() );
+
+            LOG_WARNING("Incorrect Mork value reference: %X", cell->value );
+        }
+        else if ( cell->isNumber )
+        {
+            return static_cast<unsigned int>( cell->value );
+        }
+        else
+        {
+            LOG_WARNING("Incorrect Mork value in row %d", rit.key() );
+        }
+    }
+
+    return 0;
+}
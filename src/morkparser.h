@@ -37,18 +37,221 @@
 #define __MorkParser_h__
 
 #include <QMap>
+#include <QHash>
+#include <QVector>
+#include <QFile>
 #include <QByteArray>
+#include "morkstructuralindex.h"
 class QString;
 
 // Types
 
-typedef QMap< int, QString > MorkDict;
+// A literal inside the mork data. It is kept as a view into the mork data
+// and only decoded into a string when it is requested.
+struct MorkLiteral
+{
+    MorkLiteral( int offset = 0, int length = 0, bool escaped = false )
+        : offset( offset ), length( length ), escaped( escaped ) {}
+
+    int     offset;     // Offset of the raw literal in the mork data
+    int     length;     // Length of the raw literal, including escape sequences
+    bool    escaped;    // Whether the raw literal contains \ or $xx escapes
+};
+
 typedef QMap< int, int > MorkCells;					// ColumnId : ValueId
 typedef QMap< int, MorkCells > MorkRowMap;			// Row id
 typedef QMap< int, MorkRowMap > RowScopeMap;		// Row scope
 typedef QMap< int, RowScopeMap > MorkTableMap;		// Table id
 typedef QMap< int, MorkTableMap > TableScopeMap;	// Table Scope
 
+// A cell of a row in the MorkRowStore
+struct MorkCell
+{
+    int     column;     // ColumnId
+    int     value;      // ValueId
+};
+
+// A row in the MorkRowStore. Its cells are a contiguous range of the cell storage.
+struct MorkRow
+{
+    int     tableScope;
+    int     tableId;
+    int     rowScope;
+    int     rowId;
+    int     firstCell;      // Index of the first cell in the cell storage
+    int     cellCount;      // Number of cells of the row
+    int     cellCapacity;   // Number of cells reserved for the row
+};
+
+// Flat storage of all rows of a mork file. The rows are kept in one array and the cells
+// of all rows in another one, rows are found through an open addressing hash index.
+class MorkRowStore
+{
+public:
+    MorkRowStore();
+
+    void    clear();
+
+    // Returns the index of the row, or -1 if there is no such row
+    int     findRow( int tableScope, int tableId, int rowScope, int rowId ) const;
+
+    // Returns the index of the row, which is added if it doesn't exist yet
+    int     insertRow( int tableScope, int tableId, int rowScope, int rowId );
+
+    // Sets the value of a cell of the row, replacing the value of an existing cell
+    void    setCell( int row, int column, int value );
+
+    // Adds a cell to the row, which must not have a cell of the column yet
+    void    appendCell( int row, int column, int value );
+
+    // Removes all cells of the row
+    void    clearCells( int row );
+
+    int     rowCount() const { return rows_.size(); }
+    const MorkRow & row( int row ) const { return rows_[ row ]; }
+
+    // Returns the first of the row(row).cellCount cells of the row
+    const MorkCell * cells( int row ) const { return cells_.constData() + rows_[ row ].firstCell; }
+
+    // Returns the number of bytes allocated for the storage
+    qint64  memoryUsage() const;
+
+private:
+    int     findSlot( int tableScope, int tableId, int rowScope, int rowId ) const;
+    void    growIndex();
+
+    QVector< MorkRow > rows_;
+
+    QVector< MorkCell > cells_;
+
+    // Hash index of the rows. Contains the index of the row + 1, or 0 for empty slots.
+    QVector< int > index_;
+};
+
+// Flat map from ids to values, for the dicts of a mork file. Ids with a scope can be packed
+// into a quint64 key. The entries are kept in one array in the order in which they were added
+// and are found through an open addressing hash index.
+// Clearing the map keeps its storage, so a parser which is reused for many files
+// stops allocating for its dicts once it has read the largest of them.
+template< typename T, typename Key = int >
+class MorkIdMap
+{
+public:
+    struct Entry
+    {
+        Key     id;
+        T       value;
+    };
+
+    void    clear()
+    {
+        entries_.clear();
+        index_.fill( 0 );
+    }
+
+    int     size() const { return entries_.size(); }
+    const Entry & entry( int i ) const { return entries_[ i ]; }
+
+    // Returns the value of the id, or nullptr if there is no such id
+    const T * find( Key id ) const
+    {
+        if ( index_.isEmpty() )
+            return nullptr;
+
+        const int entry = index_[ findSlot( id ) ];
+        return entry ? &entries_[ entry - 1 ].value : nullptr;
+    }
+
+    T       value( Key id, const T &defaultValue = T() ) const
+    {
+        const T * found = find( id );
+        return found ? *found : defaultValue;
+    }
+
+    // Sets the value of the id, replacing an existing value
+    void    insert( Key id, const T &value )
+    {
+        // Keep the load factor of the index at or below one half
+        if ( ( entries_.size() + 1 ) * 2 > index_.size() )
+            growIndex();
+
+        const int slot = findSlot( id );
+
+        if ( index_[ slot ] )
+        {
+            entries_[ index_[ slot ] - 1 ].value = value;
+            return;
+        }
+
+        Entry entry;
+        entry.id = id;
+        entry.value = value;
+        entries_.append( entry );
+        index_[ slot ] = entries_.size();
+    }
+
+    // Returns the number of bytes allocated for the map
+    qint64  memoryUsage() const
+    {
+        return static_cast<qint64>( entries_.capacity() ) * sizeof( Entry )
+             + static_cast<qint64>( index_.capacity() ) * sizeof( int );
+    }
+
+private:
+    int     findSlot( Key id ) const
+    {
+        // The index size is a power of two and it is never full, so probing ends at an empty slot
+        const uint mask = static_cast<uint>( index_.size() - 1 );
+        uint slot = static_cast<uint>( ( static_cast<quint64>( id ) * Q_UINT64_C( 0x9E3779B97F4A7C15 ) ) >> 32 ) & mask;
+
+        while ( index_[ slot ] && entries_[ index_[ slot ] - 1 ].id != id )
+            slot = ( slot + 1 ) & mask;
+
+        return static_cast<int>( slot );
+    }
+
+    void    growIndex()
+    {
+        // Reuse the index which was kept by clear, unless it is too small
+        index_.fill( 0, qMax( 64, qMax( index_.size(), entries_.size() * 4 ) ) );
+
+        for ( int i = 0; i < entries_.size(); i++ )
+            index_[ findSlot( entries_[ i ].id ) ] = i + 1;
+    }
+
+    QVector< Entry > entries_;
+
+    // Hash index of the entries. Contains the index of the entry + 1, or 0 for empty slots.
+    QVector< int > index_;
+};
+
+typedef MorkIdMap< MorkLiteral > MorkDict;
+
+// Set of the columns of a row, to find the duplicate cells of the row. The columns with small ids,
+// which are nearly all of them, are marked in a table with the generation of the set, so clearing
+// the set only starts a new generation. The few other columns are kept in a list.
+class MorkColumnSet
+{
+public:
+    MorkColumnSet();
+
+    // Empties the set, its storage is kept
+    void    clear();
+
+    // Adds the column, returns false if it is already in the set
+    bool    insert( int column );
+
+private:
+    // The largest size of the generation table, columns with larger ids go into the list
+    static const int MaxTableSize = 0x10000;
+
+    // The generation in which each column was added, indexed by the column id
+    QVector< quint32 > generations_;
+    quint32 generation_;
+
+    QVector< int > otherColumns_;
+};
+
 // Mork header of supported format version
 const char MorkMagicHeader[] = "// <!-- <mdb:mork:z v=\"1.4\"/> -->";
 
@@ -79,107 +282,278 @@ enum MorkTerm
 };
 
 
-/// Class MorkParser
+// The dicts of mork data
+enum MorkDictType
+{
+    ColumnDict,
+    ValueDict
+};
+
+
+/// Class MorkHandler
 
-class MorkParser
+// Receives the content of mork data from a MorkReader, in the order in which it is written.
+// Only committed groups are reported. The literals are views into the mork data, they can be
+// decoded with the reader until it loads other data.
+class MorkHandler
 {
 public:
+    virtual ~MorkHandler();
 
-    MorkParser( int defaultScope = 0x80 );
+    // A dict entry with a non-empty value. An entry replaces an earlier one with the same id.
+    virtual void onDictEntry( MorkDictType dict, int id, const MorkLiteral &value );
 
-    ///
-    /// Open and parse mork file
+    // A table starts, its rows follow until onTableEnd
+    virtual void onTableBegin( int tableScope, int tableId );
+    virtual void onTableEnd();
 
-    bool open( const QString &path );
+    // A row starts, its cells follow until onRowEnd. The table id is 0 for rows outside of
+    // a table. The row scope is the default scope if none is given.
+    // Return false to skip the cells of the row, they are then not reported.
+    virtual bool onRowBegin( int tableScope, int tableId, int rowScope, int rowId );
 
-    ///
-    /// Return error status
+    // The current row was written as a cut, all of its earlier cells are removed
+    virtual void onRowCut();
 
-    QString errorMsg();
+    // A cell with a non-empty value of the current row. The value is either a literal,
+    // or the id of an entry in the value dict. Only the first cell of a column is reported.
+    virtual void onCell( int column, const MorkLiteral &value, bool valueOid );
+    virtual void onRowEnd();
 
-    ///
-    /// Returns all tables of specified scope
+    // A row is added to a table by its id, without cells
+    virtual void onRowReference( int tableScope, int tableId, int rowScope, int rowId );
 
-    MorkTableMap *getTables( int tableScope );
+    // A committed group starts, its content follows until onGroupCommit
+    virtual void onGroupBegin();
+    virtual void onGroupCommit();
+};
 
-    ///
-    /// Returns all rows under specified scope
 
-    MorkRowMap *getRows( int rowScope, RowScopeMap *table );
+/// Class MorkReader
 
-    // Returns all rows for a specific table scope, table ID and row scope.
-    // Return an empty map if not found
-    const MorkRowMap * rows(int tablescope, int tableid, int rowscope );
+// Reads mork data and reports its content to a MorkHandler, without storing it.
+class MorkReader
+{
+public:
+
+    explicit MorkReader( MorkHandler * handler = 0, int defaultScope = 0x80 );
+    virtual ~MorkReader();
 
     ///
-    /// Return value of specified value oid
+    /// Open and read mork file. The file is memory-mapped and stays
+    /// mapped until the reader is destroyed or another file is opened.
 
-    QString getValue( int oid );
+    bool open( const QString &path );
 
     ///
-    /// Return value of specified column oid
+    /// Return error status
 
-    QString getColumn( int oid );
+    QString errorMsg();
 
-    static int dumpMorkFile( const QString& filename );
+    // Decodes the escape sequences of a literal into its raw bytes
+    QByteArray decodeLiteral( const MorkLiteral &literal ) const;
+
+    // Checks whether the literal decodes to the given string
+    bool    literalEquals( const MorkLiteral &literal, const char * string ) const;
+
+    // Converts the hex number literal to an int, returns 0 if it is not a number
+    int     literalToInt( const MorkLiteral &literal ) const;
+
+    // Converts the hex number literal to an int, without allocating unless it is escaped
+    int     literalToNumber( const MorkLiteral &literal, bool *ok ) const;
+
+    // Returns the atom of the decoded literal in the MorkAtomTable, which is added if needed
+    int     literalToAtom( const MorkLiteral &literal ) const;
+
+    // Selects how the structural chars of the files which are opened next are found,
+    // so the implementations can be compared. The best supported one is used by default.
+    void    setStructuralImplementation( MorkStructuralIndex::Implementation implementation );
 
 protected: // Members
-    void    initVars();
+    virtual void initVars();
+
+    // Releases the mork data and everything which refers to it
+    virtual void closeData();
+
+    // Maps the given range of the open mork file, or reads it if it cannot be mapped
+    void    loadData( qint64 offset, qint64 length );
 
     bool    isWhiteSpace( char c );
     char    nextChar();
 
+    // Jumps to the next structural char and reads it, like nextChar
+    char    nextStructuralChar();
+
     // Skips the sequence which must follow; throws exception if it does not
     void    skip( const char * string );
 
-    // Reads the next char, increasing the counter. Throws if no next char.
-    QChar   readNext();
+    // Reads the hex number, until the first non-hex character. Throws if it reaches the end.
+    MorkLiteral readHexNumber();
+
+    // Reads a cell after its opening bracket, including the closing bracket.
+    // The column is returned as a literal, which is a hex number or a ^oid.
+    void    readCell( MorkLiteral * column, MorkLiteral * text, bool * valueOid, bool * hasText );
+
+    // Reads a cell literal until the closing bracket, which is consumed.
+    // Sets hasText to whether the literal decodes to a non-empty string.
+    MorkLiteral readLiteral( bool * hasText );
+
+    // Finds the end marker of the group with the given id, starting at the current position.
+    // Returns the offset of the marker, or -1 if there is none.
+    int     findGroupEnd( const MorkLiteral &id, int *markerLength, bool *aborted );
 
-    // Peeks the next char, which must exist (throws if not)
-    QChar   peekNext();
+    // Checks whether the data at the offset starts with the string
+    bool    matchesAt( int offset, const char * string, int length ) const;
 
-    // Reads the hex number, until the first non-hex character
-    QString readHexNumber();
+    // Reads the id of a row after its opening bracket, returns the char following the id
+    char    readRowId( int *Id, int *Scope );
 
-    void    parseScopeId( const QString &TextId, int *Id, int *Scope );
-    void    setCurrentRow( int TableScope, int TableId, int RowScope, int RowId );
+    // Converts an id with an optional scope, like 1F:^80, to numbers
+    void    parseScopeId( const MorkLiteral &TextId, int *Id, int *Scope );
 
     // Parse methods
     void    parse();
     void    parseDict();
     void    parseComment();
-    void    parseCell(QList<int>* parsedIds = nullptr);
+    void    parseCell( MorkColumnSet* parsedIds = nullptr );
     void    parseTable();
     void    parseMeta( char c );
     void    parseRow( int TableId, int TableScope );
     void    parseGroup();
 
-protected: // Data
+    // Parses the content of a committed group, which ends at the given offset
+    void    parseGroupContent( int end );
 
-    // Columns in mork means value names
-    MorkDict columns_;
-    MorkDict values_;
+protected: // Data
 
-    // All mork file data
-    TableScopeMap mork_;
-    MorkCells *currentCells_;
-    QMap<int, QMap<int, QPair<int, int>>> rowMappings;
+    // Receives the content of the mork data
+    MorkHandler * handler_;
 
     // Error status of last operation
     QString mErrorMessage;
 
-    // All Mork data
-    QByteArray morkData_;
+    // The mork file, which is kept open while it is mapped
+    QFile morkFile_;
+
+    // Fallback storage for the mork data if the file cannot be mapped
+    QByteArray morkBuffer_;
+
+    // All Mork data, either mapped or pointing to morkBuffer_
+    const char * morkData_;
+
+    // The end of the data which is currently parsed
+    int morkEnd_;
+
+    // The structural chars of the mork data
+    MorkStructuralIndex structural_;
+    MorkStructuralIndex::Implementation structuralImplementation_;
 
     int morkPos_;
-    int nextAddValueId_;
     int defaultScope_;
 
+    // The number of bytes which findGroupEnd scanned since the reader was initialized
+    qint64 groupEndScanLength_;
+
+    // The columns of the row which is currently parsed, kept to reuse its storage
+    MorkColumnSet parsedCellIds_;
+
     // Indicates the entity that is being parsed
     enum { NPColumns, NPValues, NPRows } nowParsing_;
 };
 
 
+/// Class MorkParser
+
+// Reads mork data into the dicts and the row storage, so they can be queried afterwards.
+class MorkParser : public MorkReader, private MorkHandler
+{
+public:
+
+    MorkParser( int defaultScope = 0x80 );
+
+    ///
+    /// Returns the ids of all table scopes in ascending order
+
+    QList<int> getTableScopes() const;
+
+    ///
+    /// Returns all tables of specified scope. The maps are built from the
+    /// row storage on the first request and stay valid until the next open.
+
+    MorkTableMap *getTables( int tableScope );
+
+    ///
+    /// Returns all rows under specified scope
+
+    MorkRowMap *getRows( int rowScope, RowScopeMap *table );
+
+    // Returns all rows for a specific table scope, table ID and row scope.
+    // Return an empty map if not found
+    const MorkRowMap * rows(int tablescope, int tableid, int rowscope );
+
+    ///
+    /// Return value of specified value oid
+
+    QString getValue( int oid );
+
+    ///
+    /// Return value of specified column oid
+
+    QString getColumn( int oid );
+
+    ///
+    /// Return the oid of the column with the specified name, or 0 if there is none
+
+    int findColumn( const char * name );
+
+    ///
+    /// Release the mork file and the parsed data. The storage is kept,
+    /// so the parser can be reused for other files without allocating it again.
+
+    void reset();
+
+    static int dumpMorkFile( const QString& filename );
+
+protected: // Members
+    void initVars() override;
+    void closeData() override;
+
+    void setCurrentRow( int TableScope, int TableId, int RowScope, int RowId );
+
+protected: // Data
+
+    // Columns in mork means value names, they are kept as atoms of the MorkAtomTable
+    MorkIdMap< int > columns_;
+    MorkDict values_;
+
+    // All mork file data
+    MorkRowStore rows_;
+
+    // The index of the row which is currently parsed
+    int currentRow_;
+
+    // Whether the current row had no cells when it was started. The reader only reports
+    // the first cell of each column, so its cells don't need to be checked for duplicates.
+    bool currentRowIsEmpty_;
+
+    // The tables which have been requested via getTables
+    TableScopeMap tables_;
+
+    // The table scope and table id of the rows which were seen in a table,
+    // by row scope and row id packed with rowMappingKey
+    MorkIdMap< QPair<int, int>, quint64 > rowMappings;
+
+    int nextAddValueId_;
+
+private:
+    void onDictEntry( MorkDictType dict, int id, const MorkLiteral &value ) override;
+    bool onRowBegin( int tableScope, int tableId, int rowScope, int rowId ) override;
+    void onRowCut() override;
+    void onCell( int column, const MorkLiteral &value, bool valueOid ) override;
+    void onRowReference( int tableScope, int tableId, int rowScope, int rowId ) override;
+};
+
+
 /**
  * A mork parse for mail databases.
  */
@@ -191,4 +565,162 @@ public:
     unsigned int getNumUnreadMessages();
 };
 
+
+/**
+ * A fast mork parser for mail databases, which only extracts the number of unread emails.
+ *
+ * It only keeps the rows of the dbfolderinfo table and the dict entries which can be a
+ * number of unread emails. All other rows are skipped without being stored.
+ */
+class MorkUnreadScanner : public MorkReader, private MorkHandler {
+public:
+    MorkUnreadScanner();
+
+    /**
+     * Bring the unread counter up to date with the mork file. The first call parses the whole
+     * file, later calls only parse the transactions which were appended since the last call.
+     * The whole file is parsed again if it was replaced, truncated or otherwise rewritten.
+     * The file is not kept open between the calls.
+     *
+     * @param path The path to the mork file.
+     * @return true on success, false otherwise.
+     */
+    bool update( const QString &path );
+
+    /**
+     * @return The number of unread emails in the mork file.
+     */
+    unsigned int getNumUnreadMessages() const;
+
+    /**
+     * Save the state of the scanner, so a scanner of a later run can continue
+     * where this one stopped.
+     *
+     * @return The checkpoint, or an empty array if no file has been parsed.
+     */
+    QByteArray saveCheckpoint() const;
+
+    /**
+     * Continue from the checkpoint of an earlier scanner, so the next update only parses
+     * what was appended to the file since the checkpoint was saved. The checkpoint is rejected
+     * if it has another format version, or if the file was replaced or rewritten since.
+     *
+     * @param path The path to the mork file.
+     * @param checkpoint The checkpoint from saveCheckpoint.
+     * @return true if the checkpoint was restored, false if the next update parses the whole file.
+     */
+    bool restoreCheckpoint( const QString &path, const QByteArray &checkpoint );
+
+protected:
+    void initVars() override;
+
+private:
+    void onDictEntry( MorkDictType dict, int id, const MorkLiteral &value ) override;
+    bool onRowBegin( int tableScope, int tableId, int rowScope, int rowId ) override;
+    void onRowCut() override;
+    void onCell( int column, const MorkLiteral &value, bool valueOid ) override;
+    void onRowReference( int tableScope, int tableId, int rowScope, int rowId ) override;
+
+    /**
+     * Select the dbfolderinfo row which receives the following cells.
+     *
+     * @return Whether the row is a dbfolderinfo row.
+     */
+    bool setCurrentRow( int TableScope, int TableId, int RowScope, int RowId );
+
+    /**
+     * Parse the part of the file which was appended since the last update.
+     *
+     * @return false if the whole file needs to be parsed again.
+     */
+    bool parseTail();
+
+    /**
+     * Remember the part of the file which has been parsed.
+     *
+     * @param dataOffset The offset of the mork data in the file.
+     * @param dataEnd The end of the parsed data.
+     */
+    void setScanned( qint64 dataOffset, int dataEnd );
+
+    /**
+     * @param path The path to the mork file.
+     * @return Whether the part of the file which has been parsed is unchanged.
+     */
+    bool isScannedPartUnchanged( const QString &path ) const;
+
+    /**
+     * A cell of a dbfolderinfo row.
+     */
+    struct FolderInfoCell {
+        /**
+         * Whether the value is a reference to the values dict.
+         */
+        bool isOid;
+
+        /**
+         * Whether the value is a valid number, always true for references.
+         */
+        bool isNumber;
+
+        /**
+         * The number or the oid of the value.
+         */
+        int value;
+    };
+    typedef QMap< int, FolderInfoCell > FolderInfoCells;
+
+    /**
+     * The column ids of the dbfolderinfo row scope and the numNewMsgs column.
+     */
+    int folderInfoScope_;
+    int numNewMsgsColumn_;
+
+    /**
+     * The values dict entries which are numbers.
+     */
+    QHash< int, int > numberValues_;
+
+    /**
+     * The table scope and table id of the rows in the dbfolderinfo row scope.
+     */
+    QMap< int, QPair<int, int> > folderInfoRowMappings_;
+
+    /**
+     * The rows of the dbfolderinfo table by row id.
+     */
+    QMap< int, FolderInfoCells > folderInfoRows_;
+
+    /**
+     * The dbfolderinfo row which is currently parsed, or nullptr if the current row is skipped.
+     */
+    FolderInfoCells * currentFolderInfoRow_;
+
+    /**
+     * The identity of the parsed file, which changes if the file is replaced.
+     */
+    quint64 fileIdentity_;
+
+    /**
+     * The number of bytes of the file which have been parsed.
+     */
+    qint64 scannedSize_;
+
+    /**
+     * The last bytes before scannedSize_, used to detect a rewritten file.
+     */
+    QByteArray scannedTail_;
+
+    /**
+     * The modification time of the file before it was parsed, in ms since the epoch.
+     */
+    qint64 scannedModified_;
+
+    /**
+     * The hash of the start of the file and its length, used to detect a rewritten file.
+     */
+    QByteArray scannedPrefixHash_;
+    int scannedPrefixLength_;
+};
+
 #endif // __MorkParser_h__
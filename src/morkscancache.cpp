@@ -0,0 +1,146 @@
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include "morkscancache.h"
+#include "log.h"
+
+// Identifies a cache file, "BTMC"
+static const quint32 CACHE_MAGIC = 0x42544D43;
+
+// The version of the cache file format, which must be increased whenever the format changes.
+// The format of the checkpoints themselves is versioned by the scanner.
+static const quint32 CACHE_VERSION = 1;
+
+MorkScanCache::MorkScanCache( const QString &path )
+    : mPath( path ), mModified( false )
+{
+}
+
+bool MorkScanCache::load()
+{
+    mCheckpoints.clear();
+    mModified = false;
+
+    QFile file( mPath );
+
+    if ( !file.open( QIODevice::ReadOnly ) )
+        return false;
+
+    QDataStream in( &file );
+    in.setVersion( QDataStream::Qt_5_6 );
+
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+
+    if ( magic != CACHE_MAGIC || version != CACHE_VERSION )
+    {
+        LOG_INFO( "Ignoring the scan cache %s with an unknown format", qPrintable( mPath ) );
+        return false;
+    }
+
+    // The checksum protects against a cache file which was only partially written
+    QByteArray payload, checksum;
+    in >> payload >> checksum;
+
+    if ( in.status() != QDataStream::Ok
+         || checksum != QCryptographicHash::hash( payload, QCryptographicHash::Sha1 ) )
+    {
+        LOG_WARNING( "Ignoring the damaged scan cache %s", qPrintable( mPath ) );
+        return false;
+    }
+
+    QHash< QString, QByteArray > checkpoints;
+    QDataStream payloadIn( payload );
+    payloadIn.setVersion( QDataStream::Qt_5_6 );
+    payloadIn >> checkpoints;
+
+    if ( payloadIn.status() != QDataStream::Ok )
+    {
+        LOG_WARNING( "Ignoring the damaged scan cache %s", qPrintable( mPath ) );
+        return false;
+    }
+
+    mCheckpoints = checkpoints;
+    LOG_DEBUG( "Loaded %d checkpoints from the scan cache %s", mCheckpoints.size(), qPrintable( mPath ) );
+    return true;
+}
+
+bool MorkScanCache::save()
+{
+    QByteArray payload;
+    QDataStream payloadOut( &payload, QIODevice::WriteOnly );
+    payloadOut.setVersion( QDataStream::Qt_5_6 );
+    payloadOut << mCheckpoints;
+
+    QDir().mkpath( QFileInfo( mPath ).absolutePath() );
+
+    // Never leave a partially written cache behind
+    QSaveFile file( mPath );
+
+    if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    {
+        LOG_WARNING( "Unable to write the scan cache %s: %s", qPrintable( mPath ), qPrintable( file.errorString() ) );
+        return false;
+    }
+
+    QDataStream out( &file );
+    out.setVersion( QDataStream::Qt_5_6 );
+    out << CACHE_MAGIC << CACHE_VERSION << payload
+        << QCryptographicHash::hash( payload, QCryptographicHash::Sha1 );
+
+    if ( out.status() != QDataStream::Ok || !file.commit() )
+    {
+        LOG_WARNING( "Unable to write the scan cache %s: %s", qPrintable( mPath ), qPrintable( file.errorString() ) );
+        return false;
+    }
+
+    mModified = false;
+    return true;
+}
+
+QByteArray MorkScanCache::checkpoint( const QString &path ) const
+{
+    return mCheckpoints.value( path );
+}
+
+void MorkScanCache::setCheckpoint( const QString &path, const QByteArray &checkpoint )
+{
+    QHash< QString, QByteArray >::iterator it = mCheckpoints.find( path );
+
+    if ( it != mCheckpoints.end() && it.value() == checkpoint )
+        return;
+
+    mCheckpoints.insert( path, checkpoint );
+    mModified = true;
+}
+
+void MorkScanCache::removeCheckpoint( const QString &path )
+{
+    if ( mCheckpoints.remove( path ) > 0 )
+        mModified = true;
+}
+
+void MorkScanCache::retain( const QStringList &paths )
+{
+    for ( QHash< QString, QByteArray >::iterator it = mCheckpoints.begin(); it != mCheckpoints.end(); )
+    {
+        if ( paths.contains( it.key() ) )
+        {
+            ++it;
+        }
+        else
+        {
+            it = mCheckpoints.erase( it );
+            mModified = true;
+        }
+    }
+}
+
+bool MorkScanCache::isModified() const
+{
+    return mModified;
+}
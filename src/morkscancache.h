@@ -0,0 +1,78 @@
+#ifndef MORKSCANCACHE_H
+#define MORKSCANCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+// Keeps the checkpoints of the Mork unread scanners in a file, so after a restart
+// only the parts of the Mork files which were appended in the meantime need to be parsed.
+// The file is only a cache: if it is missing, damaged or from another version, it is ignored
+// and the Mork files are parsed completely.
+class MorkScanCache
+{
+    public:
+        /**
+         * @param path The path to the cache file.
+         */
+        explicit MorkScanCache( const QString& path );
+
+        /**
+         * Load the checkpoints from the cache file, replacing the current ones.
+         *
+         * @return true if the checkpoints were loaded, false if the file was missing or invalid.
+         */
+        bool    load();
+
+        /**
+         * Write the checkpoints to the cache file.
+         *
+         * @return true on success, false otherwise.
+         */
+        bool    save();
+
+        /**
+         * @param path The path to a Mork file.
+         * @return The checkpoint of the scanner of the file, or an empty array if there is none.
+         */
+        QByteArray  checkpoint( const QString& path ) const;
+
+        /**
+         * Store the checkpoint of the scanner of a Mork file.
+         *
+         * @param path The path to the Mork file.
+         * @param checkpoint The checkpoint from MorkUnreadScanner::saveCheckpoint.
+         */
+        void    setCheckpoint( const QString& path, const QByteArray& checkpoint );
+
+        /**
+         * Remove the checkpoint of a Mork file.
+         *
+         * @param path The path to the Mork file.
+         */
+        void    removeCheckpoint( const QString& path );
+
+        /**
+         * Remove the checkpoints of all Mork files which are not in the list.
+         *
+         * @param paths The paths to the Mork files which are still watched.
+         */
+        void    retain( const QStringList& paths );
+
+        /**
+         * @return Whether the checkpoints changed since they were loaded or saved.
+         */
+        bool    isModified() const;
+
+    private:
+        // The path to the cache file
+        const QString   mPath;
+
+        // Maps the paths to the Mork files to the checkpoints of their scanners
+        QHash< QString, QByteArray >    mCheckpoints;
+
+        bool    mModified;
+};
+
+#endif // MORKSCANCACHE_H
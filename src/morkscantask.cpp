@@ -0,0 +1,67 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QThreadPool>
+
+#include "morkscantask.h"
+#include "morkparser.h"
+
+const qint64 MorkFileFingerprint::TAIL_SIZE;
+
+MorkFileFingerprint MorkFileFingerprint::of( const QString& path )
+{
+    MorkFileFingerprint fingerprint;
+    QFile file( path );
+
+    if ( !file.open( QIODevice::ReadOnly ) )
+        return fingerprint;
+
+    fingerprint.size = file.size();
+    fingerprint.modified = QFileInfo( file ).lastModified();
+
+    if ( file.seek( qMax<qint64>( 0, fingerprint.size - TAIL_SIZE ) ) )
+        fingerprint.tailHash = qHash( file.read( TAIL_SIZE ) );
+
+    return fingerprint;
+}
+
+bool MorkFileFingerprint::operator ==( const MorkFileFingerprint& other ) const
+{
+    return size == other.size && modified == other.modified && tailHash == other.tailHash;
+}
+
+bool MorkFileFingerprint::operator !=( const MorkFileFingerprint& other ) const
+{
+    return !( *this == other );
+}
+
+MorkScanTask::MorkScanTask( const QString& path, MorkUnreadScanner * parser, const QByteArray& checkpoint )
+    : mPath( path ), mParser( parser ), mSuccess( false ), mSkipped( false ), mCheckpoint( checkpoint )
+{
+    setAutoDelete( false );
+}
+
+void MorkScanTask::run()
+{
+    // A new scanner continues from the checkpoint of the last run, if the file wasn't rewritten
+    if ( !mCheckpoint.isEmpty() )
+        mParser->restoreCheckpoint( mPath, mCheckpoint );
+
+    mSuccess = mParser->update( mPath );
+    mCheckpoint = mSuccess ? mParser->saveCheckpoint() : QByteArray();
+}
+
+void MorkScanTask::runAll( QThreadPool& pool, const QList<MorkScanTask *>& tasks )
+{
+    // Dispatching a single task to the pool would only add the thread handover
+    if ( tasks.size() == 1 )
+    {
+        tasks.first()->run();
+        return;
+    }
+
+    for ( MorkScanTask * task : tasks )
+        pool.start( task );
+
+    pool.waitForDone();
+}
@@ -0,0 +1,71 @@
+#ifndef MORKSCANTASK_H
+#define MORKSCANTASK_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QRunnable>
+#include <QString>
+
+class MorkUnreadScanner;
+class QThreadPool;
+
+// A cheap fingerprint of a Mork file, which changes whenever Betterbird writes to the file.
+// Betterbird either appends its changes or rewrites the whole file, so only the size,
+// the modification time and the last TAIL_SIZE bytes of the file are compared. An edit which
+// keeps the size and the modification time and lies before the tail is not detected.
+struct MorkFileFingerprint
+{
+    // The size of the end of the file which is hashed into the fingerprint
+    static const qint64 TAIL_SIZE = 4096;
+
+    qint64      size = -1;
+    QDateTime   modified;
+
+    // Hash of the end of the file, where Betterbird appends its changes
+    uint        tailHash = 0;
+
+    /**
+     * @param path The path to the Mork file.
+     * @return The fingerprint of the file, or an empty fingerprint if the file can't be read.
+     */
+    static MorkFileFingerprint of( const QString& path );
+
+    bool operator ==( const MorkFileFingerprint& other ) const;
+    bool operator !=( const MorkFileFingerprint& other ) const;
+};
+
+// Updates the scanner of a single Mork file, on a thread of the scan pool
+class MorkScanTask : public QRunnable
+{
+    public:
+        /**
+         * @param path The path to the Mork file.
+         * @param parser The scanner of the file, which must outlive the task.
+         * @param checkpoint The checkpoint to restore before the update, or an empty array.
+         */
+        MorkScanTask( const QString& path, MorkUnreadScanner * parser, const QByteArray& checkpoint );
+
+        void run() override;
+
+        /**
+         * Run the tasks and wait until all of them are done. A single task is run on the calling
+         * thread, more than one are run in parallel by the pool. The tasks are not deleted.
+         *
+         * @param pool The pool which runs the tasks.
+         * @param tasks The tasks to run.
+         */
+        static void runAll( QThreadPool& pool, const QList<MorkScanTask *>& tasks );
+
+        const QString       mPath;
+        MorkUnreadScanner * mParser;
+        bool                mSuccess;
+
+        // The file didn't change since it was parsed the last time
+        bool                mSkipped;
+
+        // The checkpoint to restore before the update, and the one of the scanner after it
+        QByteArray          mCheckpoint;
+};
+
+#endif // MORKSCANTASK_H
@@ -0,0 +1,252 @@
+#include <string.h>
+
+#include "morkstructuralindex.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define MORK_HAVE_SSE2
+#  include <emmintrin.h>
+#endif
+
+// AVX2 is only compiled in where it can be enabled per function and detected at runtime
+#if defined(MORK_HAVE_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#  define MORK_HAVE_AVX2
+#  define MORK_TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+#  include <immintrin.h>
+#elif defined(MORK_HAVE_SSE2) && defined(_MSC_VER)
+#  define MORK_HAVE_AVX2
+#  define MORK_TARGET_AVX2
+#  include <immintrin.h>
+#  include <intrin.h>
+#endif
+
+static MorkStructuralIndex::BlockMasks scalarMasks( const char * block )
+{
+    MorkStructuralIndex::BlockMasks masks = { 0, 0 };
+
+    for ( int i = 0; i < 64; i++ )
+    {
+        if ( MorkStructuralIndex::isStructural( block[ i ] ) )
+            masks.structural |= Q_UINT64_C( 1 ) << i;
+
+        if ( MorkStructuralIndex::isLiteralSpecial( block[ i ] ) )
+            masks.literal |= Q_UINT64_C( 1 ) << i;
+    }
+
+    return masks;
+}
+
+#ifdef MORK_HAVE_SSE2
+static const char StructuralChars[] = "<>{}[]()@/\\$^=\n\r";
+
+// The structural chars plus the null char, which ends the data for the parser
+static const int StructuralCharCount = sizeof( StructuralChars );
+
+static MorkStructuralIndex::BlockMasks sse2Masks( const char * block )
+{
+    MorkStructuralIndex::BlockMasks masks = { 0, 0 };
+
+    for ( int i = 0; i < 64; i += 16 )
+    {
+        const __m128i data = _mm_loadu_si128( reinterpret_cast<const __m128i *>( block + i ) );
+        const __m128i literal = _mm_or_si128( _mm_or_si128(
+                _mm_cmpeq_epi8( data, _mm_set1_epi8( ')' ) ),
+                _mm_cmpeq_epi8( data, _mm_set1_epi8( '\\' ) ) ),
+                _mm_cmpeq_epi8( data, _mm_set1_epi8( '$' ) ) );
+        __m128i structural = literal;
+
+        for ( int c = 0; c < StructuralCharCount; c++ )
+            structural = _mm_or_si128( structural, _mm_cmpeq_epi8( data, _mm_set1_epi8( StructuralChars[ c ] ) ) );
+
+        masks.structural |= static_cast<quint64>( static_cast<quint16>( _mm_movemask_epi8( structural ) ) ) << i;
+        masks.literal |= static_cast<quint64>( static_cast<quint16>( _mm_movemask_epi8( literal ) ) ) << i;
+    }
+
+    return masks;
+}
+#endif
+
+#ifdef MORK_HAVE_AVX2
+// Each char is classified by looking up both of its nibbles, a char belongs to the classes
+// whose bits are set in both lookups. The bits 0 to 5 are the structural chars by their high
+// nibble, bit 6 is $ and ) and bit 7 is \.
+static const quint8 LowNibbleClasses[ 16 ] = {
+        0x09, 0x00, 0x00, 0x00, 0x42, 0x00, 0x00, 0x00, 0x02, 0x42, 0x01, 0x30, 0x94, 0x35, 0x14, 0x02 };
+static const quint8 HighNibbleClasses[ 16 ] = {
+        0x01, 0x00, 0x42, 0x04, 0x08, 0x90, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+MORK_TARGET_AVX2 static MorkStructuralIndex::BlockMasks avx2Masks( const char * block )
+{
+    MorkStructuralIndex::BlockMasks masks = { 0, 0 };
+    const __m256i lowTable = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128( reinterpret_cast<const __m128i *>( LowNibbleClasses ) ) );
+    const __m256i highTable = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128( reinterpret_cast<const __m128i *>( HighNibbleClasses ) ) );
+    const __m256i nibble = _mm256_set1_epi8( 0x0F );
+    const __m256i zero = _mm256_setzero_si256();
+
+    for ( int i = 0; i < 64; i += 32 )
+    {
+        const __m256i data = _mm256_loadu_si256( reinterpret_cast<const __m256i *>( block + i ) );
+        const __m256i classes = _mm256_and_si256(
+                _mm256_shuffle_epi8( lowTable, _mm256_and_si256( data, nibble ) ),
+                _mm256_shuffle_epi8( highTable, _mm256_and_si256( _mm256_srli_epi16( data, 4 ), nibble ) ) );
+        const __m256i structural = _mm256_cmpeq_epi8( _mm256_and_si256( classes, _mm256_set1_epi8( 0x3F ) ), zero );
+        const __m256i literal = _mm256_cmpeq_epi8( _mm256_and_si256( classes, _mm256_set1_epi8( static_cast<char>( 0xC0 ) ) ), zero );
+
+        // The comparisons found the chars without a class
+        masks.structural |= static_cast<quint64>( ~static_cast<quint32>( _mm256_movemask_epi8( structural ) ) ) << i;
+        masks.literal |= static_cast<quint64>( ~static_cast<quint32>( _mm256_movemask_epi8( literal ) ) ) << i;
+    }
+
+    return masks;
+}
+
+// Checks whether the CPU and the operating system support AVX2
+static bool cpuHasAvx2()
+{
+#ifdef _MSC_VER
+    int info[ 4 ];
+    __cpuid( info, 0 );
+
+    if ( info[ 0 ] < 7 )
+        return false;
+
+    // The OS must save the AVX registers
+    __cpuid( info, 1 );
+
+    if ( !( info[ 2 ] & ( 1 << 27 ) ) || ( _xgetbv( 0 ) & 6 ) != 6 )
+        return false;
+
+    __cpuidex( info, 7, 0 );
+    return ( info[ 1 ] & ( 1 << 5 ) ) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" );
+#endif
+}
+#endif
+
+MorkStructuralIndex::MorkStructuralIndex()
+{
+    reset( 0, 0 );
+}
+
+void MorkStructuralIndex::reset( const char * data, int length, Implementation implementation )
+{
+    data_ = data;
+    length_ = data ? length : 0;
+    maskFunction_ = maskFunction( implementation );
+    block_ = -1;
+    blockMasks_.structural = 0;
+    blockMasks_.literal = 0;
+}
+
+bool MorkStructuralIndex::isSupported( Implementation implementation )
+{
+    switch ( implementation )
+    {
+        case Implementation::Best:
+        case Implementation::Scalar:
+            return true;
+
+        case Implementation::Sse2:
+#ifdef MORK_HAVE_SSE2
+            return true;
+#else
+            return false;
+#endif
+
+        case Implementation::Avx2:
+#ifdef MORK_HAVE_AVX2
+        {
+            static const bool supported = cpuHasAvx2();
+            return supported;
+        }
+#else
+            return false;
+#endif
+    }
+
+    return false;
+}
+
+bool MorkStructuralIndex::isStructural( char c )
+{
+    switch ( c )
+    {
+        case '<':
+        case '>':
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case '(':
+        case ')':
+        case '@':
+        case '/':
+        case '\\':
+        case '$':
+        case '^':
+        case '=':
+        case '\n':
+        case '\r':
+        case '\0':
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+bool MorkStructuralIndex::isLiteralSpecial( char c )
+{
+    return c == ')' || c == '\\' || c == '$';
+}
+
+MorkStructuralIndex::MaskFunction MorkStructuralIndex::maskFunction( Implementation implementation )
+{
+    if ( implementation == Implementation::Best )
+    {
+        if ( isSupported( Implementation::Avx2 ) )
+            implementation = Implementation::Avx2;
+        else if ( isSupported( Implementation::Sse2 ) )
+            implementation = Implementation::Sse2;
+        else
+            implementation = Implementation::Scalar;
+    }
+    else if ( !isSupported( implementation ) )
+    {
+        implementation = Implementation::Scalar;
+    }
+
+    switch ( implementation )
+    {
+#ifdef MORK_HAVE_AVX2
+        case Implementation::Avx2:
+            return avx2Masks;
+#endif
+
+#ifdef MORK_HAVE_SSE2
+        case Implementation::Sse2:
+            return sse2Masks;
+#endif
+
+        default:
+            return scalarMasks;
+    }
+}
+
+MorkStructuralIndex::BlockMasks MorkStructuralIndex::blockMasks( int block ) const
+{
+    const int offset = block * BlockSize;
+
+    if ( length_ - offset >= BlockSize )
+        return maskFunction_( data_ + offset );
+
+    // The last block is copied, so the SIMD loads don't read past the end of the data
+    char padded[ BlockSize ];
+    const int length = length_ - offset;
+    memcpy( padded, data_ + offset, length );
+    memset( padded + length, ' ', BlockSize - length );
+    return maskFunction_( padded );
+}
@@ -0,0 +1,110 @@
+#ifndef MORKSTRUCTURALINDEX_H
+#define MORKSTRUCTURALINDEX_H
+
+#include <QtAlgorithms>
+#include <QtGlobal>
+
+// Finds the structural chars of mork data, which are <>{}[]()@/\$^= and the line breaks
+// and null chars. The other chars are only text and white space, which the parser can jump over.
+// Inside of literals, only the chars )\$ have a meaning, they are indexed separately.
+//
+// Like the first stage of simdjson, the data is classified with SIMD instructions into bitmaps
+// with one bit per byte. The bitmaps are built 64 bytes at a time while the parser advances,
+// so the memory use doesn't grow with the size of the data.
+class MorkStructuralIndex
+{
+public:
+    // The ways to classify a block of data, the best supported one is chosen at runtime
+    enum class Implementation
+    {
+        Best,
+        Scalar,
+        Sse2,
+        Avx2
+    };
+
+    MorkStructuralIndex();
+
+    // Starts indexing the data, which must stay valid until the next reset
+    void reset( const char * data, int length, Implementation implementation = Implementation::Best );
+
+    // Returns the offset of the first structural char at or after the offset,
+    // or the length of the data if there is none
+    int next( int offset )
+    {
+        return nextInMask( offset, &BlockMasks::structural );
+    }
+
+    // Returns the offset of the first ), \ or $ at or after the offset,
+    // or the length of the data if there is none
+    int nextInLiteral( int offset )
+    {
+        return nextInMask( offset, &BlockMasks::literal );
+    }
+
+    // Checks whether the implementation can be used on this CPU
+    static bool isSupported( Implementation implementation );
+
+    // Checks whether the char is a structural char
+    static bool isStructural( char c );
+
+    // Checks whether the char has a meaning inside of a literal
+    static bool isLiteralSpecial( char c );
+
+    // The bitmaps of a block of data
+    struct BlockMasks
+    {
+        quint64 structural;
+        quint64 literal;
+    };
+
+private:
+    typedef BlockMasks ( *MaskFunction )( const char * block );
+
+    inline int nextInMask( int offset, quint64 BlockMasks::* mask );
+
+    // Returns the bitmaps of the block with the given index, for the bytes inside the data
+    BlockMasks blockMasks( int block ) const;
+
+    static MaskFunction maskFunction( Implementation implementation );
+
+    static const int BlockSize = 64;
+
+    const char * data_;
+    int length_;
+    MaskFunction maskFunction_;
+
+    // The index of the block whose bitmaps are cached
+    int block_;
+    BlockMasks blockMasks_;
+};
+
+inline int MorkStructuralIndex::nextInMask( int offset, quint64 BlockMasks::* mask )
+{
+    if ( offset >= length_ )
+        return length_;
+
+    int block = offset / BlockSize;
+
+    if ( block != block_ )
+    {
+        block_ = block;
+        blockMasks_ = blockMasks( block );
+    }
+
+    quint64 bits = blockMasks_.*mask & ( ~Q_UINT64_C( 0 ) << ( offset % BlockSize ) );
+
+    while ( !bits )
+    {
+        if ( ++block * BlockSize >= length_ )
+            return length_;
+
+        block_ = block;
+        blockMasks_ = blockMasks( block );
+        bits = blockMasks_.*mask;
+    }
+
+    return block * BlockSize + qCountTrailingZeroBits( bits );
+}
+
+#endif // MORKSTRUCTURALINDEX_H
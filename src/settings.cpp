@@ -72,6 +72,7 @@ Settings::Settings()
     mUnreadOpacityLevel = 0.75;
     mNewEmailMenuEnabled = false;
     mIndexFilesRereadIntervalSec = 0;
+    mUnreadScanThreads = 0;
     mBetterbirdCmdLine = Utils::getDefaultBetterbirdCommand();
     mIgnoreNETWMhints = false;
 }
@@ -119,6 +120,7 @@ void Settings::save()
     out[ "advanced/ignoreUpdateVersion" ] = mIgnoreUpdateVersion;
     out[ ONLY_SHOW_ICON_ON_UNREAD_MESSAGES_KEY ] = onlyShowIconOnUnreadMessages;
     out[ "advanced/forcedRereadInterval" ] = static_cast<int>( mIndexFilesRereadIntervalSec );
+    out[ "advanced/unreadScanThreads" ] = static_cast<int>( mUnreadScanThreads );
     out[ "advanced/runProcessOnChange" ] = mProcessRunOnCountChange;
     out[ "advanced/ignoreNetWMhints" ] = mIgnoreNETWMhints;
 
@@ -171,6 +173,12 @@ void Settings::save()
     file.commit();
 }
 
+QString Settings::getConfigFilePath(const QString &name) const
+{
+    // Portable installs keep the file next to the executable, like the settings
+    return QFileInfo( mSettingsFilename ).dir().filePath( name );
+}
+
 void Settings::load()
 {
     // Load the settings file
@@ -259,6 +267,7 @@ void Settings::fromJSON( const QJsonObject& settings )
     onlyShowIconOnUnreadMessages = settings.value(ONLY_SHOW_ICON_ON_UNREAD_MESSAGES_KEY).toBool();
     mIgnoreUpdateVersion = settings.value("advanced/ignoreUpdateVersion").toString();
     mIndexFilesRereadIntervalSec = settings.value("advanced/forcedRereadInterval").toInt();
+    mUnreadScanThreads = settings.value("advanced/unreadScanThreads").toInt();
     mProcessRunOnCountChange = settings.value( "advanced/runProcessOnChange" ).toString();
     mIgnoreNETWMhints = settings.value( "advanced/ignoreNetWMhints").toBool();
 
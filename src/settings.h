@@ -154,6 +154,9 @@ class Settings
         // If non-zero, specifies an interval in seconds for rereading index files even if they didn't change. 0 disables.
         unsigned int    mIndexFilesRereadIntervalSec;
 
+        // The number of threads reading the index files in parallel. 0 uses one thread per CPU core.
+        unsigned int    mUnreadScanThreads;
+
         // When the number of unread emails changes, Birdtray can start this process
         QString                   mProcessRunOnCountChange;
 
@@ -183,6 +186,12 @@ class Settings
          */
         void setNotificationIcon(const QPixmap& icon);
 
+        /**
+         * @param name The name of a file which belongs to the configuration, like a cache.
+         * @return The path to the file, next to the settings file.
+         */
+        QString getConfigFilePath(const QString& name) const;
+
     private:
         Q_DECLARE_TR_FUNCTIONS(Settings)
     
@@ -1,9 +1,7 @@
 #include <QMenu>
 #include <QTimer>
-#include <QPainter>
 #include <QProcess>
 #include <QMessageBox>
-#include <QPainterPath>
 #include <QtNetwork/QNetworkSession>
 
 #include "trayicon.h"
@@ -15,10 +13,12 @@
 #include "log.h"
 
 TrayIcon::TrayIcon(bool showSettings)
+    : mRenderer(BirdtrayApp::get()->getSettings())
 {
     mBlinkingIconOpacity = 1.0;
     mBlinkingDelta = 0.0;
     mBlinkingTimeout = 0;
+    mBlinkFrame = -1;
 
     mUnreadCounter = 0;
 
@@ -118,7 +118,7 @@ UnreadMonitor* TrayIcon::getUnreadMonitor() const {
 
 void TrayIcon::unreadCounterUpdate( unsigned int total, QColor color )
 {
-    Log::debug("unreadCounterUpdate %d", total );
+    LOG_DEBUG("unreadCounterUpdate %d", total );
     Settings* settings = BirdtrayApp::get()->getSettings();
     if (settings->ignoreUnreadCountOnStart && !haveUnreadMailsData) {
         // Ignore unread emails that are present at Birdtray startup.
@@ -140,9 +140,9 @@ void TrayIcon::unreadCounterUpdate( unsigned int total, QColor color )
         cmdline.replace( "%OLD%", QString::number( mUnreadCounter ) );
 
         if ( !QProcess::startDetached( cmdline ) )
-            Log::debug( "Failed to execute hook command %s", qPrintable( cmdline ) );
+            LOG_WARNING( "Failed to execute hook command %s", qPrintable( cmdline ) );
         else
-            Log::debug( "Executing hook command %s", qPrintable( cmdline ) );
+            LOG_INFO( "Executing hook command %s", qPrintable( cmdline ) );
     }
 
     mUnreadCounter = total;
@@ -161,30 +161,6 @@ void TrayIcon::unreadMonitorWarningChanged(const QString &path) {
     updateIcon();
 }
 
-// Shamelessly stolen from Spivak Karaoke Player: github.com/gyunaev/spivak
-static unsigned int largestFontSize(const QFont &font, int minfontsize, int maxfontsize, const QString &text, const QSize& rectsize )
-{
-    int cursize = minfontsize;
-    QFont testfont( font );
-
-    // We are trying to find the maximum font size which fits by doing the binary search
-    while ( maxfontsize - minfontsize > 1 )
-    {
-        cursize = minfontsize + (maxfontsize - minfontsize) / 2;
-        testfont.setPointSize( cursize );
-        testfont.setWeight(
-                static_cast<int>(BirdtrayApp::get()->getSettings()->mNotificationFontWeight));
-        QSize size = QFontMetrics( testfont ).size( Qt::TextSingleLine, text );
-
-        if ( size.width() < rectsize.width() && size.height() <= rectsize.height() )
-            minfontsize = cursize;
-        else
-            maxfontsize = cursize;
-    }
-
-    return cursize;
-}
-
 void TrayIcon::updateIcon()
 {
     Settings* settings = BirdtrayApp::get()->getSettings();
@@ -215,72 +191,6 @@ void TrayIcon::updateIcon()
         return;
     }
 
-    QPixmap temp(settings->getNotificationIcon().size());
-    QPainter p;
-
-    temp.fill( Qt::transparent );
-    p.begin( &temp );
-
-    // We use 0.75 opacity if we have unread count and non-blinking.
-    // We use blinking opacity if we have unread count and blinking.
-    // And we use 1.0 if we have zero unread count
-    if ( !mSnoozedUntil.isNull() )
-        p.setOpacity( 0.5 );
-    else if ( unread == 0 )
-        p.setOpacity( 1.0 );
-    else
-        p.setOpacity( mBlinkingIconOpacity );
-
-    if (unread != 0 && !settings->mNotificationIconUnread.isNull()) {
-        p.drawPixmap(settings->mNotificationIconUnread.rect(), settings->mNotificationIconUnread);
-    } else {
-        p.drawPixmap(settings->getNotificationIcon().rect(), settings->getNotificationIcon());
-    }
-
-    p.setFont(settings->mNotificationFont);
-
-    // Do we need to draw error sign?
-    if (settings->mMonitorBetterbirdWindow && !mBetterbirdWindowExists) {
-        p.setOpacity( 1.0 );
-        QPen pen( Qt::red );
-        pen.setWidth( (temp.width() * 10) / 100 );
-        p.setPen( pen );
-        p.drawLine( 2, 2, temp.width() - 3, temp.height() - 3 );
-        p.drawLine( temp.width() - 3, 2, 2, temp.height() - 3 );
-        unread = 0;
-    }
-
-    // Do we need to draw the unread counter?
-    if (unread > 0 && settings->mShowUnreadEmailCount) {
-        // Find the suitable font size, starting from 4
-        QString countvalue = QString::number( unread );
-
-        int fontsize = static_cast<int>(largestFontSize(
-                settings->mNotificationFont,
-                static_cast<int>(settings->mNotificationMinimumFontSize),
-                static_cast<int>(settings->mNotificationMaximumFontSize),
-                countvalue, temp.size() - QSize(2, 2)));
-
-        settings->mNotificationFont.setPointSize(fontsize);
-        settings->mNotificationFont.setWeight(static_cast<int>(settings->mNotificationFontWeight));
-        QFontMetrics fm(settings->mNotificationFont);
-        p.setOpacity( mBlinkingTimeout ? 1.0 - mBlinkingIconOpacity : 1.0 );
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 11, 0))
-        int width = fm.horizontalAdvance(countvalue);
-#else
-        int width = fm.width(countvalue);
-#endif
-        QPainterPath textPath;
-        textPath.addText((temp.width() - width) / 2.0,
-                (temp.height() - fm.height()) / 2.0 + fm.ascent(),
-                settings->mNotificationFont, countvalue);
-        if (settings->mNotificationBorderWidth > 0
-            && settings->mNotificationBorderColor.isValid()) {
-            p.strokePath(textPath, QPen(
-                    settings->mNotificationBorderColor, settings->mNotificationBorderWidth));
-        }
-        p.fillPath(textPath, mUnreadColor);
-    }
     const QMap<QString, QString> warnings = mUnreadMonitor->getWarnings();
     if (warnings.isEmpty()) {
         setToolTip(QString());
@@ -310,20 +220,76 @@ void TrayIcon::updateIcon()
             toolTip << name + ": " + warning;
         }
         setToolTip(toolTip.join('\n'));
-        drawWarningIndicator(p, temp.size());
     }
 
-    p.end();
+    TrayIconState state = iconState( unread, mBlinkingIconOpacity, !warnings.isEmpty() );
 
-    // FIXME: this is not very efficient, although at our icon sizes (128x128) is probably ok.
-    if ( mLastDrawnIcon != temp.toImage() )
+    // While blinking, the opacity is one of the frames of the blinking cycle
+    bool blinkFrame = mBlinkFrame >= 0 && !state.snoozed && unread > 0;
+
+    if ( blinkFrame && ( mBlinkFrames.isEmpty() || !state.sameContent( mBlinkFrameStates.first() ) ) )
+        renderBlinkFrames( unread, state.warning );
+
+    if ( !mIconStateShown || state != mShownIconState )
     {
-        mLastDrawnIcon = temp.toImage();
-        setIcon( temp );
+        setIcon( blinkFrame ? mBlinkFrames[ mBlinkFrame ] : mRenderer.icon( state ) );
+        mShownIconState = state;
+        mIconStateShown = true;
     }
     this->show();
 }
 
+TrayIconState TrayIcon::iconState(unsigned int unread, double blinkingOpacity, bool warning) const
+{
+    Settings* settings = BirdtrayApp::get()->getSettings();
+    TrayIconState state;
+    state.snoozed = !mSnoozedUntil.isNull();
+    state.unread = unread;
+    state.warning = warning;
+
+    // We use 0.5 opacity if we are snoozed, blinking opacity if we have unread count,
+    // and 1.0 if we have zero unread count. The opacity is rounded to steps of 1%,
+    // so the blinking runs through a limited number of icons.
+    if ( state.snoozed )
+        state.iconOpacity = 50;
+    else if ( unread == 0 )
+        state.iconOpacity = 100;
+    else
+        state.iconOpacity = qRound( blinkingOpacity * 100 );
+
+    state.windowMissing = settings->mMonitorBetterbirdWindow && !mBetterbirdWindowExists;
+
+    // The color and text opacity only matter if the unread counter is drawn
+    if (unread > 0 && settings->mShowUnreadEmailCount && !state.windowMissing) {
+        state.color = mUnreadColor.rgba();
+        state.textOpacity = qRound( ( mBlinkingTimeout ? 1.0 - blinkingOpacity : 1.0 ) * 100 );
+    } else {
+        state.textOpacity = 0;
+    }
+    return state;
+}
+
+void TrayIcon::renderBlinkFrames(unsigned int unread, bool warning)
+{
+    mBlinkFrames.clear();
+    mBlinkFrameStates.clear();
+
+    for ( double opacity : mBlinkOpacities )
+    {
+        TrayIconState state = iconState( unread, opacity, warning );
+        mBlinkFrameStates.append( state );
+        mBlinkFrames.append( mRenderer.icon( state ) );
+    }
+}
+
+void TrayIcon::invalidateIconCache()
+{
+    mRenderer.invalidate();
+    mBlinkFrames.clear();
+    mBlinkFrameStates.clear();
+    mIconStateShown = false;
+}
+
 void TrayIcon::enableBlinking(bool enabled)
 {
     if ( enabled )
@@ -342,6 +308,32 @@ void TrayIcon::enableBlinking(bool enabled)
             mBlinkingTimeout = settings->mBlinkSpeed * 50;
         }
 
+        // The opacities of a whole blinking cycle, the blinking timer steps through them
+        mBlinkOpacities.clear();
+
+        if ( mBlinkingDelta != 0.0 )
+        {
+            // Fade out from the full opacity and back in
+            double opacity = mBlinkingIconOpacity;
+            double delta = -mBlinkingDelta;
+
+            do
+            {
+                if ( opacity + delta > 1.0 || opacity + delta < 0.0 )
+                    delta = -delta;
+
+                opacity += delta;
+                mBlinkOpacities.append( opacity );
+            }
+            while ( delta < 0.0 || opacity + delta <= 1.0 );
+        }
+        else
+        {
+            // Flip the opacity
+            mBlinkOpacities.append( settings->mUnreadOpacityLevel );
+            mBlinkOpacities.append( 1.0 - settings->mUnreadOpacityLevel );
+        }
+
         mBlinkingTimer.setInterval( mBlinkingTimeout );
         mBlinkingTimer.start();
     }
@@ -351,7 +343,13 @@ void TrayIcon::enableBlinking(bool enabled)
         mBlinkingIconOpacity = 1.0;
         mBlinkingDelta = 0.0;
         mBlinkingTimeout = 0;
+        mBlinkOpacities.clear();
     }
+
+    // The frames are rendered again on the next blinking cycle
+    mBlinkFrame = -1;
+    mBlinkFrames.clear();
+    mBlinkFrameStates.clear();
 }
 
 void TrayIcon::updateState()
@@ -423,29 +421,20 @@ void TrayIcon::updateState()
 
 void TrayIcon::blinkTimeout()
 {
-    // Apply blinking fade-in/fade-out, if needed
-    if ( mBlinkingDelta != 0.0 )
-    {
-        if ( mBlinkingIconOpacity + mBlinkingDelta > 1.0 || mBlinkingIconOpacity + mBlinkingDelta < 0.0 )
-            mBlinkingDelta = -mBlinkingDelta;
+    if ( mBlinkOpacities.isEmpty() )
+        return;
 
-        mBlinkingIconOpacity += mBlinkingDelta;
-    }
-    else
+    // Step to the next frame of the blinking cycle
+    mBlinkFrame = ( mBlinkFrame + 1 ) % mBlinkOpacities.size();
+    mBlinkingIconOpacity = mBlinkOpacities[ mBlinkFrame ];
+
+    // If the frames show what is shown right now, we only need to switch to the next one
+    if ( mIconStateShown && !mBlinkFrames.isEmpty()
+         && mShownIconState.sameContent( mBlinkFrameStates.first() ) )
     {
-        Settings* settings = BirdtrayApp::get()->getSettings();
-        // We are either not blinking at all, or doing no transition
-        // this depends on nonzero settings->mBlinkSpeed
-        if (settings->mBlinkSpeed != 0) {
-            // Flip the opacity
-            if (mBlinkingIconOpacity == settings->mUnreadOpacityLevel) {
-                mBlinkingIconOpacity = 1.0 - settings->mUnreadOpacityLevel;
-            } else {
-                mBlinkingIconOpacity = settings->mUnreadOpacityLevel;
-            }
-        } else {
-            mBlinkingIconOpacity = settings->mUnreadOpacityLevel;
-        }
+        setIcon( mBlinkFrames[ mBlinkFrame ] );
+        mShownIconState = mBlinkFrameStates[ mBlinkFrame ];
+        return;
     }
 
     updateIcon();
@@ -480,8 +469,9 @@ void TrayIcon::showSettings()
         // Recreate menu
         createMenu();
 
-        // Recalculate the delta
+        // Recalculate the delta, and render the icons with the new settings
         enableBlinking( false );
+        invalidateIconCache();
         updateIcon();
         // TODO: Update on betterbird path setting change
 
@@ -514,7 +504,7 @@ void TrayIcon::actionSnoozeFor()
     QAction * action = (QAction *) sender();
     mSnoozedUntil = QDateTime::currentDateTimeUtc().addSecs( action->data().toInt() );
 
-    Log::debug( "Snoozed until %s UTC", qPrintable(mSnoozedUntil.toString() ) );
+    LOG_INFO( "Snoozed until %s UTC", qPrintable(mSnoozedUntil.toString() ) );
 
     // Unhide the unsnoozer
     mMenuUnsnooze->setVisible( true );
@@ -686,11 +676,11 @@ void TrayIcon::startBetterbird()
 
     if ( !BirdtrayApp::get()->getSettings()->getStartBetterbirdCmdline( executable, args ) )
     {
-        Log::debug("Failed to get Betterbird command-line" );
+        LOG_WARNING("Failed to get Betterbird command-line" );
         return;
     }
 
-    Log::debug("Starting Betterbird as '%s %s'", qPrintable(executable), qPrintable(args.join(' ')));
+    LOG_INFO("Starting Betterbird as '%s %s'", qPrintable(executable), qPrintable(args.join(' ')));
 
     if ( mBetterbirdProcess )
         mBetterbirdProcess->deleteLater();
@@ -698,6 +688,12 @@ void TrayIcon::startBetterbird()
     mBetterbirdProcess = new QProcess();
     connect( mBetterbirdProcess, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(bbProcessFinished(int,QProcess::ExitStatus)) );
 
+    // Let the window lookup prefer the windows of our process
+    connect( mBetterbirdProcess, &QProcess::started, this, [this]() {
+        if ( mWinTools && mBetterbirdProcess )
+            mWinTools->setProcessId( mBetterbirdProcess->processId() );
+    });
+
 #if QT_VERSION >= QT_VERSION_CHECK(5, 6, 0)
     connect( mBetterbirdProcess, &QProcess::errorOccurred, this, &TrayIcon::bbProcessError );
 #endif
@@ -735,6 +731,9 @@ void TrayIcon::bbProcessFinished(int, QProcess::ExitStatus)
         return;
     }
 #endif /* Q_OS_WIN */
+    if ( mWinTools )
+        mWinTools->setProcessId( 0 );
+
     mBetterbirdProcess->deleteLater();
     mBetterbirdProcess = nullptr;
 }
@@ -819,7 +818,7 @@ void TrayIcon::setIgnoredUnreadMails(unsigned int ignoredMails, bool updateIcon)
     if (ignoredMails == ignoredUnreadEmails) {
         return;
     }
-    Log::debug("Setting ignored unread mails to %u", ignoredMails);
+    LOG_INFO("Setting ignored unread mails to %u", ignoredMails);
     ignoredUnreadEmails = ignoredMails;
     if (mMenuIgnoreUnreads) {
         if (ignoredUnreadEmails > 0) {
@@ -840,20 +839,3 @@ void TrayIcon::doAutoUpdateCheck() {
             this, &TrayIcon::onAutoUpdateCheckFinished);
     autoUpdater->checkForUpdates();
 }
-
-void TrayIcon::drawWarningIndicator(QPainter &painter, const QSize &iconSize) {
-    painter.setOpacity(1.0);
-    int width = iconSize.width() / 4;
-    QPen pen(QColor(255, 200, 0, 255));
-    pen.setWidth(width);
-    painter.setPen(pen);
-    int x = iconSize.width() - static_cast<int>(iconSize.width() * 0.125) - pen.width() / 2;
-    painter.drawLine(x, static_cast<int>(iconSize.height() * 0.33),
-            x, iconSize.height() - width / 2);
-    pen.setColor(QColor(255, 120, 0, 255));
-    pen.setWidthF(std::max(pen.width() - 16, 1));
-    painter.setPen(pen);
-    painter.drawLine(x, static_cast<int>(iconSize.height() * 0.33),
-            x, iconSize.height() - 20 - width);
-    painter.drawPoint(x, iconSize.height() - width / 2);
-}
@@ -4,7 +4,9 @@
 #include <QTimer>
 #include <QDateTime>
 #include <QWidget>
-#include <QImage>
+#include <QHash>
+#include <QIcon>
+#include <QVector>
 #include <QProcess>
 #include <QSystemTrayIcon>
 #include <QtNetwork/QNetworkConfigurationManager>
@@ -12,6 +14,7 @@
 #  include "processhandle.h"
 #endif /* Q_OS_WIN */
 #include "dialogsettings.h"
+#include "trayiconrenderer.h"
 
 class UnreadMonitor;
 class WindowTools;
@@ -144,11 +147,24 @@ class TrayIcon : public QSystemTrayIcon
         void    doAutoUpdateCheck();
         
         /**
-         * Draw the warning indicator.
-         * @param painter The painter to use when drawing.
-         * @param iconSize The size of the icon image to draw on in pixel.
+         * @param unread The shown unread count.
+         * @param blinkingOpacity The current opacity of the blinking.
+         * @param warning Whether the warning indicator is shown.
+         * @return The state to show in the icon.
          */
-        static void drawWarningIndicator(QPainter &painter, const QSize &iconSize);
+        TrayIconState iconState(unsigned int unread, double blinkingOpacity, bool warning) const;
+
+        /**
+         * Render the icons of all frames of the blinking cycle.
+         * @param unread The shown unread count.
+         * @param warning Whether the warning indicator is shown.
+         */
+        void    renderBlinkFrames(unsigned int unread, bool warning);
+
+        /**
+         * Drop the rendered icons and the fitted font sizes, e.g. after the settings changed.
+         */
+        void    invalidateIconCache();
 
         // State variables for blinking; mBlinkingTimeout=0 means we are not blinking
         double          mBlinkingIconOpacity;
@@ -156,6 +172,15 @@ class TrayIcon : public QSystemTrayIcon
         unsigned int    mBlinkingTimeout;
         QTimer          mBlinkingTimer;
 
+        // The opacities of the blinking cycle, and the current frame of it (-1 before the first)
+        QVector<double> mBlinkOpacities;
+        int             mBlinkFrame;
+
+        // The rendered frames of the blinking cycle for the current unread count and color,
+        // and the states they show
+        QVector<QIcon>  mBlinkFrames;
+        QVector<TrayIconState> mBlinkFrameStates;
+
         // To distinguish whe
         bool            mBlinkTick;
 
@@ -200,8 +225,12 @@ class TrayIcon : public QSystemTrayIcon
         // Window tools (show/hide)
         WindowTools *   mWinTools;
 
-        // Cached last drawn icon
-        QImage          mLastDrawnIcon;
+        // Renders the icons and keeps the rendered ones by the state they show
+        TrayIconRenderer mRenderer;
+
+        // The state shown by the current icon, valid if mIconStateShown is true
+        TrayIconState   mShownIconState;
+        bool            mIconStateShown = false;
 
         // Betterbird process which we have started. This can be nullptr if Betterbird
         // was started before Birdtray (thus our process would just activate it and exit)
@@ -0,0 +1,176 @@
+#include <QPainter>
+#include <QPainterPath>
+
+#include "trayiconrenderer.h"
+#include "settings.h"
+
+// The maximum number of rendered icons to keep, enough for a full blinking cycle
+static const int ICON_CACHE_SIZE = 64;
+
+bool TrayIconState::operator==(const TrayIconState &other) const
+{
+    return unread == other.unread && color == other.color
+        && iconOpacity == other.iconOpacity && textOpacity == other.textOpacity
+        && snoozed == other.snoozed && warning == other.warning
+        && windowMissing == other.windowMissing;
+}
+
+bool TrayIconState::sameContent(const TrayIconState &other) const
+{
+    return unread == other.unread && color == other.color
+        && snoozed == other.snoozed && warning == other.warning
+        && windowMissing == other.windowMissing;
+}
+
+uint qHash(const TrayIconState &state, uint seed)
+{
+    uint flags = (state.snoozed ? 1u : 0u) | (state.warning ? 2u : 0u)
+            | (state.windowMissing ? 4u : 0u);
+    uint hash = qHash(state.unread, seed);
+    hash = hash * 31 + qHash(state.color);
+    hash = hash * 31 + static_cast<uint>((state.iconOpacity << 8) | state.textOpacity);
+    return hash * 31 + flags;
+}
+
+// Shamelessly stolen from Spivak Karaoke Player: github.com/gyunaev/spivak
+static unsigned int largestFontSize(const QFont &font, int minfontsize, int maxfontsize, const QString &text, const QSize& rectsize )
+{
+    int cursize = minfontsize;
+    QFont testfont( font );
+
+    // We are trying to find the maximum font size which fits by doing the binary search
+    while ( maxfontsize - minfontsize > 1 )
+    {
+        cursize = minfontsize + (maxfontsize - minfontsize) / 2;
+        testfont.setPointSize( cursize );
+        QSize size = QFontMetrics( testfont ).size( Qt::TextSingleLine, text );
+
+        if ( size.width() < rectsize.width() && size.height() <= rectsize.height() )
+            minfontsize = cursize;
+        else
+            maxfontsize = cursize;
+    }
+
+    return cursize;
+}
+
+TrayIconRenderer::TrayIconRenderer(Settings *settings)
+    : mSettings(settings)
+{
+    mIconCache.setMaxCost( ICON_CACHE_SIZE );
+}
+
+QIcon TrayIconRenderer::icon(const TrayIconState &state)
+{
+    QIcon * icon = mIconCache.object( state );
+
+    if ( !icon )
+    {
+        icon = new QIcon( render( state ) );
+        mIconCache.insert( state, icon );
+    }
+
+    return *icon;
+}
+
+QPixmap TrayIconRenderer::render(const TrayIconState &state)
+{
+    Settings* settings = mSettings;
+    QPixmap temp(settings->getNotificationIcon().size());
+    QPainter p;
+
+    temp.fill( Qt::transparent );
+    p.begin( &temp );
+    p.setOpacity( state.iconOpacity / 100.0 );
+
+    if (state.unread != 0 && !settings->mNotificationIconUnread.isNull()) {
+        p.drawPixmap(settings->mNotificationIconUnread.rect(), settings->mNotificationIconUnread);
+    } else {
+        p.drawPixmap(settings->getNotificationIcon().rect(), settings->getNotificationIcon());
+    }
+
+    // Do we need to draw error sign?
+    if (state.windowMissing) {
+        p.setOpacity( 1.0 );
+        QPen pen( Qt::red );
+        pen.setWidth( (temp.width() * 10) / 100 );
+        p.setPen( pen );
+        p.drawLine( 2, 2, temp.width() - 3, temp.height() - 3 );
+        p.drawLine( temp.width() - 3, 2, 2, temp.height() - 3 );
+    }
+
+    // Do we need to draw the unread counter?
+    if (state.unread > 0 && settings->mShowUnreadEmailCount && !state.windowMissing) {
+        QString countvalue = QString::number( state.unread );
+        QFont font(settings->mNotificationFont);
+        font.setPointSize(fittedFontSize(countvalue.length(), temp.size() - QSize(2, 2)));
+        font.setWeight(static_cast<int>(settings->mNotificationFontWeight));
+        QFontMetrics fm(font);
+        p.setOpacity( state.textOpacity / 100.0 );
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 11, 0))
+        int width = fm.horizontalAdvance(countvalue);
+#else
+        int width = fm.width(countvalue);
+#endif
+        QPainterPath textPath;
+        textPath.addText((temp.width() - width) / 2.0,
+                (temp.height() - fm.height()) / 2.0 + fm.ascent(), font, countvalue);
+        if (settings->mNotificationBorderWidth > 0
+            && settings->mNotificationBorderColor.isValid()) {
+            p.strokePath(textPath, QPen(
+                    settings->mNotificationBorderColor, settings->mNotificationBorderWidth));
+        }
+        p.fillPath(textPath, QColor::fromRgba(state.color));
+    }
+
+    if (state.warning) {
+        drawWarningIndicator(p, temp.size());
+    }
+
+    p.end();
+    return temp;
+}
+
+int TrayIconRenderer::fittedFontSize(int digits, const QSize &rectSize)
+{
+    QHash<int, int>::const_iterator it = mFontSizeByDigits.constFind(digits);
+    if (it != mFontSizeByDigits.cend()) {
+        return it.value();
+    }
+
+    // The digits have the same width in almost all fonts,
+    // so the fitted size only depends on the number of digits
+    QFont font(mSettings->mNotificationFont);
+    font.setWeight(static_cast<int>(mSettings->mNotificationFontWeight));
+    int fontsize = static_cast<int>(largestFontSize(
+            font,
+            static_cast<int>(mSettings->mNotificationMinimumFontSize),
+            static_cast<int>(mSettings->mNotificationMaximumFontSize),
+            QString(digits, '0'), rectSize));
+
+    mFontSizeByDigits.insert(digits, fontsize);
+    return fontsize;
+}
+
+void TrayIconRenderer::invalidate()
+{
+    mIconCache.clear();
+    mFontSizeByDigits.clear();
+}
+
+void TrayIconRenderer::drawWarningIndicator(QPainter &painter, const QSize &iconSize) {
+    painter.setOpacity(1.0);
+    int width = iconSize.width() / 4;
+    QPen pen(QColor(255, 200, 0, 255));
+    pen.setWidth(width);
+    painter.setPen(pen);
+    int x = iconSize.width() - static_cast<int>(iconSize.width() * 0.125) - pen.width() / 2;
+    painter.drawLine(x, static_cast<int>(iconSize.height() * 0.33),
+            x, iconSize.height() - width / 2);
+    pen.setColor(QColor(255, 120, 0, 255));
+    pen.setWidthF(std::max(pen.width() - 16, 1));
+    painter.setPen(pen);
+    painter.drawLine(x, static_cast<int>(iconSize.height() * 0.33),
+            x, iconSize.height() - 20 - width);
+    painter.drawPoint(x, iconSize.height() - width / 2);
+}
@@ -0,0 +1,76 @@
+#ifndef TRAYICONRENDERER_H
+#define TRAYICONRENDERER_H
+
+#include <QCache>
+#include <QColor>
+#include <QHash>
+#include <QIcon>
+#include <QPixmap>
+
+class QPainter;
+class Settings;
+
+// Everything which is shown by the tray icon. The rendered icons are cached by it.
+struct TrayIconState
+{
+    // The shown unread count, and its color
+    unsigned int    unread = 0;
+    QRgb            color = 0;
+
+    // Opacity of the icon and the unread count in percent
+    int             iconOpacity = 100;
+    int             textOpacity = 100;
+
+    bool            snoozed = false;
+    bool            warning = false;
+
+    // The Betterbird window is monitored, but doesn't exist
+    bool            windowMissing = false;
+
+    bool operator==(const TrayIconState &other) const;
+    bool operator!=(const TrayIconState &other) const { return !(*this == other); }
+
+    // Whether the states show the same, except for the opacities
+    bool sameContent(const TrayIconState &other) const;
+};
+
+uint qHash(const TrayIconState &state, uint seed = 0);
+
+// Renders the tray icon for a state with the current settings, and keeps the rendered icons.
+// This doesn't need a TrayIcon, so the rendering can be measured on its own.
+class TrayIconRenderer
+{
+    public:
+        explicit TrayIconRenderer( Settings * settings );
+
+        // Returns the icon from the icon cache, which is rendered if it isn't cached yet
+        QIcon   icon( const TrayIconState &state );
+
+        // Renders the icon, without using the icon cache
+        QPixmap render( const TrayIconState &state );
+
+        // Drops the rendered icons and the fitted font sizes, e.g. after the settings changed
+        void    invalidate();
+
+        /**
+         * Draw the warning indicator.
+         * @param painter The painter to use when drawing.
+         * @param iconSize The size of the icon image to draw on in pixel.
+         */
+        static void drawWarningIndicator(QPainter &painter, const QSize &iconSize);
+
+    private:
+        // Returns the largest font size of the unread count with this number of digits
+        // which fits the rectangle
+        int     fittedFontSize( int digits, const QSize &rectSize );
+
+        Settings *      mSettings;
+
+        // The rendered icons by the state they show
+        QCache<TrayIconState, QIcon> mIconCache;
+
+        // The fitted font size of the unread count by its number of digits
+        QHash<int, int> mFontSizeByDigits;
+};
+
+#endif // TRAYICONRENDERER_H
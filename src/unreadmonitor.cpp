@@ -7,31 +7,51 @@
 #include "log.h"
 #include "birdtrayapp.h"
 
+// The name of the file with the checkpoints of the Mork scanners, in the config directory
+static const char MORK_SCAN_CACHE_FILE[] = "birdtray-mork-cache.bin";
+
+// The delay in milliseconds before changed checkpoints are written to the scan cache file
+static const int SCAN_CACHE_SAVE_DELAY = 60000;
+
 UnreadMonitor::UnreadMonitor( TrayIcon * parent )
-    : QThread( 0 ), mChangedMSFtimer(this), mForceUpdateTimer(this)
+    : QThread( 0 ), mMorkScanCache( BirdtrayApp::get()->getSettings()->getConfigFilePath( MORK_SCAN_CACHE_FILE ) ),
+      mScanCacheTimer(this), mDBWatcher(this), mChangedMSFtimer(this), mForceUpdateTimer(this)
 {
     moveToThread( this );
     mLastReportedUnread = 0;
+    mParsedFilesCount = 0;
+    mSkippedFilesCount = 0;
 
     // We get notification once Mork files have been modified.
-    connect( &mDBWatcher, &QFileSystemWatcher::fileChanged, this, &UnreadMonitor::watchedFileChanges );
+    connect( &mDBWatcher, &decltype(mDBWatcher)::fileChanged, this, &UnreadMonitor::watchedFileChanges );
 
     // Settings changed
     connect( parent, &TrayIcon::settingsChanged, this, &UnreadMonitor::slotSettingsChanged );
 
     // Set up the watched file timer
-    mChangedMSFtimer.setInterval(BirdtrayApp::get()->getSettings()->mWatchFileTimeout);
     mChangedMSFtimer.setSingleShot( true );
+    mClock.start();
 
-    connect( &mChangedMSFtimer, &QTimer::timeout, this, &UnreadMonitor::updateUnread );
+    connect( &mChangedMSFtimer, &QTimer::timeout, this, &UnreadMonitor::changedFilesTimeout );
 
     // Set up the forced update timer
     mForceUpdateTimer.setSingleShot( false );
     connect( &mForceUpdateTimer, &QTimer::timeout, this, &UnreadMonitor::forceUpdateUnread );
+
+    // Set up the scan cache timer
+    mScanCacheTimer.setSingleShot( true );
+    mScanCacheTimer.setInterval( SCAN_CACHE_SAVE_DELAY );
+    connect( &mScanCacheTimer, &QTimer::timeout, this, &UnreadMonitor::saveMorkScanCache );
+
+    updateScanThreadCount();
 }
 
 void UnreadMonitor::run()
 {
+    // The checkpoints let the first update skip what was already parsed before the restart
+    mMorkScanCache.load();
+    mMorkScanCache.retain( BirdtrayApp::get()->getSettings()->watchedMorkFiles.orderedKeys() );
+
     // Start it as soon as thread starts its event loop
     QTimer::singleShot( 0, [=](){ updateUnread(); } );
     
@@ -45,6 +65,9 @@ void UnreadMonitor::run()
 
     // Start the event loop
     exec();
+
+    mScanCacheTimer.stop();
+    saveMorkScanCache();
 }
 
 const QMap<QString, QString> &UnreadMonitor::getWarnings() const {
@@ -63,12 +86,18 @@ void UnreadMonitor::slotSettingsChanged()
     else
         mForceUpdateTimer.stop();
     
-    mChangedMSFtimer.setInterval(static_cast<int>(settings->mWatchFileTimeout));
+    // The debounce windows depend on the watch file timeout, and all files are read anyway
+    mFileChanges.clear();
+    mChangedMSFtimer.stop();
+    updateScanThreadCount();
 
     // We reinitialize everything because the settings changed
     mMorkUnreadCounts.clear();
+    mMorkScanners.clear();
+    mMorkFingerprints.clear();
 
     const QStringList &accountsList = settings->watchedMorkFiles.orderedKeys();
+    mMorkScanCache.retain(accountsList);
     for (const QString &path : warnings.keys()) {
         if (!accountsList.contains(path)) {
             clearWarning(path);
@@ -79,15 +108,56 @@ void UnreadMonitor::slotSettingsChanged()
 
 void UnreadMonitor::watchedFileChanges(const QString &filechanged)
 {
-    if ( !mChangedMSFfiles.contains( filechanged ) )
-        mChangedMSFfiles.push_back( filechanged );
+    const qint64 baseWindow = BirdtrayApp::get()->getSettings()->mWatchFileTimeout;
+    mFileChanges[filechanged].recordChange(mClock.elapsed(), baseWindow);
+    scheduleChangedFiles();
+}
+
+void UnreadMonitor::changedFilesTimeout()
+{
+    const qint64 now = mClock.elapsed();
+    for (QMap<QString, FileChangeState>::iterator it = mFileChanges.begin(); it != mFileChanges.end(); ++it) {
+        if (it->pendingSince >= 0 && changeDeadline(it.value()) <= now) {
+            if (!mChangedMSFfiles.contains(it.key())) {
+                mChangedMSFfiles.push_back(it.key());
+            }
+            it->pendingSince = -1;
+        }
+    }
 
-    mChangedMSFtimer.start();
+    if (!mChangedMSFfiles.isEmpty()) {
+        updateUnread();
+    }
+    scheduleChangedFiles();
+}
+
+qint64 UnreadMonitor::changeDeadline(const FileChangeState &state) const
+{
+    return state.deadline(BirdtrayApp::get()->getSettings()->mWatchFileTimeout);
+}
+
+void UnreadMonitor::scheduleChangedFiles()
+{
+    qint64 deadline = -1;
+    for (const FileChangeState &state : mFileChanges) {
+        if (state.pendingSince >= 0) {
+            const qint64 fileDeadline = changeDeadline(state);
+            if (deadline < 0 || fileDeadline < deadline) {
+                deadline = fileDeadline;
+            }
+        }
+    }
+
+    if (deadline < 0) {
+        mChangedMSFtimer.stop();
+    } else {
+        mChangedMSFtimer.start(static_cast<int>(qMax<qint64>(0, deadline - mClock.elapsed())));
+    }
 }
 
 void UnreadMonitor::updateUnread()
 {
-    Log::debug("Triggering the unread counter update");
+    LOG_DEBUG("Triggering the unread counter update");
 
     // We execute a single statement and then parse the groups and decide on colors.
     QColor chosenColor;
@@ -127,8 +197,9 @@ void UnreadMonitor::getUnreadCount_Mork(int &count, QColor &color)
     if ( rescanall )
     {
         mMorkUnreadCounts.clear();
-        for (const QString &path : settings->watchedMorkFiles.orderedKeys()) {
-            mMorkUnreadCounts[path] = getMorkUnreadCount(path);
+        const QStringList &paths = settings->watchedMorkFiles.orderedKeys();
+        updateMorkUnreadCounts(paths);
+        for (const QString &path : paths) {
             if (!mDBWatcher.files().contains(path) && !mDBWatcher.addPath(path)) {
                 setWarning(tr("Unable to watch %1 for changes.")
                         .arg(QFileInfo(path).fileName()), path);
@@ -139,8 +210,7 @@ void UnreadMonitor::getUnreadCount_Mork(int &count, QColor &color)
     }
     else
     {
-        for ( QString path : mChangedMSFfiles )
-            mMorkUnreadCounts[ path ] = getMorkUnreadCount( path );
+        updateMorkUnreadCounts( mChangedMSFfiles );
     }
 
     // Find the total, and set the color
@@ -164,19 +234,80 @@ void UnreadMonitor::getUnreadCount_Mork(int &count, QColor &color)
     mChangedMSFfiles.clear();
 }
 
-int UnreadMonitor::getMorkUnreadCount(const QString &path)
+void UnreadMonitor::updateMorkUnreadCounts(const QList<QString> &paths)
 {
-    MailMorkParser parser;
-    if (!parser.open(path)) {
-        Log::debug("Unable to parser mork file %s: %s", qPrintable( path ), qPrintable(parser.errorMsg()));
-        setWarning(tr("Unable to read from %1.").arg(QFileInfo(path).fileName()), path);
-        return 0;
-    } else {
+    // We only need the unread counter, so use the scanner which skips all message rows.
+    // It is kept between the updates, so it only needs to parse what was appended to the file.
+    // The parsers are independent of each other, so each one can run on its own thread.
+    // Files which didn't change since they were parsed the last time are skipped.
+    QList<MorkScanTask *> tasks;
+    QList<MorkScanTask *> parseTasks;
+    for (const QString &path : paths) {
+        QSharedPointer<MorkUnreadScanner> &parser = mMorkScanners[path];
+        QByteArray checkpoint;
+        if (parser.isNull()) {
+            parser.reset(new MorkUnreadScanner());
+            checkpoint = mMorkScanCache.checkpoint(path);
+        }
+        MorkScanTask *task = new MorkScanTask(path, parser.data(), checkpoint);
+        tasks.append(task);
+
+        MorkFileFingerprint fingerprint = MorkFileFingerprint::of(path);
+        if (mMorkFingerprints.contains(path) && mMorkFingerprints[path] == fingerprint) {
+            task->mSkipped = true;
+            task->mSuccess = true;
+        } else {
+            mMorkFingerprints[path] = fingerprint;
+            parseTasks.append(task);
+        }
+    }
+
+    MorkScanTask::runAll(mScanPool, parseTasks);
+    mParsedFilesCount += parseTasks.size();
+    mSkippedFilesCount += tasks.size() - parseTasks.size();
+    LOG_DEBUG("Parsed %d Mork files, skipped %d unchanged files (%u parsed, %u skipped in total)",
+            parseTasks.size(), tasks.size() - parseTasks.size(), mParsedFilesCount, mSkippedFilesCount);
+
+    // Warnings are only changed from the monitor thread
+    for (MorkScanTask *task : tasks) {
+        const QString &path = task->mPath;
+        if (!task->mSuccess) {
+            LOG_WARNING("Unable to parser mork file %s: %s", qPrintable( path ), qPrintable(task->mParser->errorMsg()));
+            setWarning(tr("Unable to read from %1.").arg(QFileInfo(path).fileName()), path);
+            mMorkScanners.remove(path);
+            mMorkFingerprints.remove(path);
+            mMorkScanCache.removeCheckpoint(path);
+            mMorkUnreadCounts[path] = 0;
+            continue;
+        }
         clearWarning(path);
+        if (!task->mSkipped) {
+            mMorkScanCache.setCheckpoint(path, task->mCheckpoint);
+        }
+        int unread = static_cast<int>(task->mParser->getNumUnreadMessages());
+        if (!task->mSkipped) {
+            LOG_DEBUG("Unread counter for %s: %d", qPrintable( path ), unread );
+        }
+        mMorkUnreadCounts[path] = unread;
+    }
+    qDeleteAll(tasks);
+
+    if (mMorkScanCache.isModified() && !mScanCacheTimer.isActive()) {
+        mScanCacheTimer.start();
     }
-    int unread = static_cast<int>(parser.getNumUnreadMessages());
-    Log::debug("Unread counter for %s: %d", qPrintable( path ), unread );
-    return unread;
+}
+
+void UnreadMonitor::saveMorkScanCache()
+{
+    if (mMorkScanCache.isModified()) {
+        mMorkScanCache.save();
+    }
+}
+
+void UnreadMonitor::updateScanThreadCount()
+{
+    unsigned int threads = BirdtrayApp::get()->getSettings()->mUnreadScanThreads;
+    mScanPool.setMaxThreadCount(threads > 0 ? static_cast<int>(threads) : QThread::idealThreadCount());
 }
 
 void UnreadMonitor::setWarning(const QString &message, const QString &path) {
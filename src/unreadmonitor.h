@@ -7,9 +7,21 @@
 #include <QMap>
 #include <QTimer>
 #include <QStringList>
+#ifdef Q_OS_LINUX
+#include "inotifywatcher.h"
+#else
 #include <QFileSystemWatcher>
+#endif /* Q_OS_LINUX */
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QElapsedTimer>
+
+#include "filechangestate.h"
+#include "morkscancache.h"
+#include "morkscantask.h"
 
 class TrayIcon;
+class MorkUnreadScanner;
 
 class UnreadMonitor : public QThread
 {
@@ -48,9 +60,32 @@ class UnreadMonitor : public QThread
         // This one forces rereading Mork files
         void    forceUpdateUnread();
 
+    private slots:
+        // Updates the unread counts of the changed files whose debounce window expired
+        void    changedFilesTimeout();
+
+        // Writes the checkpoints of the Mork scanners to the scan cache file
+        void    saveMorkScanCache();
+
     private:
+        // The time at which the pending change of the file needs to be handled
+        qint64  changeDeadline( const FileChangeState& state ) const;
+
+        // Starts the changed files timer for the earliest deadline of the changed files
+        void    scheduleChangedFiles();
+
         void    getUnreadCount_Mork( int & count, QColor& color );
-        int     getMorkUnreadCount( const QString& path );
+
+        /**
+         * Read the unread counts of the given Mork files into mMorkUnreadCounts.
+         * If there is more than one file, the files are parsed in parallel by the scan pool.
+         *
+         * @param paths The paths to the Mork files.
+         */
+        void    updateMorkUnreadCounts( const QList<QString>& paths );
+
+        // Applies the number of scan threads from the settings to the scan pool
+        void    updateScanThreadCount();
     
         /**
          * Set a warning for a given path or for all paths, if no path is given.
@@ -73,16 +108,47 @@ class UnreadMonitor : public QThread
         // Maps the Mork files to unread counts
         QMap< QString, quint32 >  mMorkUnreadCounts;
 
-        // Watches the files for changes
+        // Keeps the parser state of each Mork file, so only the appended changes need to be parsed
+        QMap< QString, QSharedPointer<MorkUnreadScanner> >  mMorkScanners;
+
+        // The fingerprints of the Mork files when they were parsed the last time
+        QMap< QString, MorkFileFingerprint >  mMorkFingerprints;
+
+        // The checkpoints of the scanners, so after a restart the scanners continue where they stopped
+        MorkScanCache       mMorkScanCache;
+
+        // The scan cache is written a while after the checkpoints changed, as Betterbird
+        // often changes the files several times in a row
+        QTimer              mScanCacheTimer;
+
+        // Parses multiple Mork files in parallel
+        QThreadPool         mScanPool;
+
+        // Number of Mork file updates which needed parsing or were skipped because the file didn't change
+        unsigned int        mParsedFilesCount;
+        unsigned int        mSkippedFilesCount;
+
+        // Watches the files for changes. On Linux their directories are watched with inotify,
+        // so the files are still watched after Betterbird replaced them.
+#ifdef Q_OS_LINUX
+        InotifyWatcher      mDBWatcher;
+#else
         QFileSystemWatcher  mDBWatcher;
+#endif /* Q_OS_LINUX */
 
         // Betterbird tends to do lots of modifications to the MSF file
         // each time a new email arrives. This results in lots of notifications,
-        // and thus lots of unread calls. To avoid this, we set up the timer each
-        // time a new notification is issued, and reset it for each further notification.
-        // We only read the file(s) if the timer expires.
+        // and thus lots of unread calls. To avoid this, each file is only read once
+        // it didn't change for its debounce window. The timer expires at the earliest
+        // deadline of all changed files.
         QTimer              mChangedMSFtimer;
 
+        // The debounce state of the watched files
+        QMap< QString, FileChangeState >  mFileChanges;
+
+        // The clock for the debounce times
+        QElapsedTimer       mClock;
+
         // List of changed files (for MSF monitoring)
         QList<QString>      mChangedMSFfiles;
 
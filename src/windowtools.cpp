@@ -1,17 +1,24 @@
 #include <QtCore>
 
 #include "windowtools.h"
+#include "birdtrayapp.h"
 #if defined (Q_OS_WIN)
 #  include "windowtools_win.h"
 #elif defined (Q_OS_MAC)
 // TODO
+#elif defined (USE_XCB_WINDOWTOOLS)
+#  include "windowtools_xcb.h"
 #else
 #  include "windowtools_x11.h"
 #endif
 
 
+// The time after which a lookup searches again for a window which wasn't found, in ms
+static const qint64 LOOKUP_RETRY_INTERVAL = 5000;
+
+
 WindowTools::WindowTools()
-    : QObject()
+    : QObject(), mProcessId( 0 ), mLookupNeeded( true ), mLookupIgnoreNETWMhints( false )
 {
 }
 
@@ -19,6 +26,35 @@ WindowTools::~WindowTools()
 {
 }
 
+void WindowTools::setProcessId( qint64 pid )
+{
+    mProcessId = pid;
+
+    // Another window may be preferred now
+    requestLookup();
+}
+
+void WindowTools::requestLookup()
+{
+    mLookupNeeded = true;
+}
+
+bool WindowTools::startLookup()
+{
+    const Settings * settings = BirdtrayApp::get()->getSettings();
+
+    if ( !mLookupNeeded && mLastLookup.isValid() && !mLastLookup.hasExpired( LOOKUP_RETRY_INTERVAL )
+         && settings->mBetterbirdWindowMatch == mLookupMatch
+         && settings->mIgnoreNETWMhints == mLookupIgnoreNETWMhints )
+        return false;
+
+    mLookupNeeded = false;
+    mLookupMatch = settings->mBetterbirdWindowMatch;
+    mLookupIgnoreNETWMhints = settings->mIgnoreNETWMhints;
+    mLastLookup.start();
+    return true;
+}
+
 
 WindowTools *WindowTools::create()
 {
@@ -30,6 +66,8 @@ WindowTools *WindowTools::create()
     tools = new WindowTools_Win();
 #elif defined (Q_OS_MAC)
     tools = 0;
+#elif defined (USE_XCB_WINDOWTOOLS)
+    tools = new WindowTools_Xcb();
 #else
     tools = new WindowTools_X11();
 #endif
@@ -2,6 +2,8 @@
 #define WINDOWTOOLSBASE_H
 
 #include <QObject>
+#include <QElapsedTimer>
+#include <QString>
 
 class WindowTools : public QObject
 {
@@ -29,6 +31,10 @@ class WindowTools : public QObject
         // Return true if Betterbird window is valid (hidden or shown)
         virtual bool    isValid() = 0;
 
+        // Remembers the process ID of the Betterbird process which we started,
+        // so its window can be preferred in lookup. 0 means unknown.
+        void            setProcessId( qint64 pid );
+
     signals:
         /**
          * Called when the Betterbird window is hidden.
@@ -43,6 +49,29 @@ class WindowTools : public QObject
     protected:
         WindowTools();
         virtual ~WindowTools();
+
+        // Makes the next lookup search for the window, e.g. because new windows were mapped
+        void            requestLookup();
+
+        // Checks whether lookup has to search for the window, and if so, starts the search.
+        // A search is needed if one was requested, if the window match settings changed,
+        // or if the last search was a while ago. The retries catch what the events don't tell,
+        // e.g. a window which gets the matching title only after it was mapped.
+        bool            startLookup();
+
+        // The process ID of the Betterbird process which we started, or 0
+        qint64          mProcessId;
+
+    private:
+        // Set if the next lookup has to search for the window
+        bool            mLookupNeeded;
+
+        // The window match settings used in the last search
+        QString         mLookupMatch;
+        bool            mLookupIgnoreNETWMhints;
+
+        // The time since the last search
+        QElapsedTimer   mLastLookup;
 };
 
 #endif // WINDOWTOOLSBASE_H
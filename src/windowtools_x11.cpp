@@ -1,4 +1,5 @@
 #include <QTimer>
+#include <QCoreApplication>
 
 #include "birdtrayapp.h"
 #include "windowtools_x11.h"
@@ -15,6 +16,58 @@
  * and adapted it for KWin on Plasma 5.
  */
 
+/*
+ * The atoms we use. They are interned once, with a single request to the X server.
+ */
+enum X11Atom
+{
+    ATOM_WM_STATE,
+    ATOM_NET_WM_STATE,
+    ATOM_NET_WM_STATE_MODAL,
+    ATOM_NET_WM_STATE_HIDDEN,
+    ATOM_NET_WM_WINDOW_TYPE,
+    ATOM_NET_WM_WINDOW_TYPE_NORMAL,
+    ATOM_NET_WM_WINDOW_TYPE_DIALOG,
+    ATOM_NET_WM_NAME,
+    ATOM_NET_WM_PID,
+    ATOM_UTF8_STRING,
+    ATOM_NET_CLIENT_LIST,
+    ATOM_NET_ACTIVE_WINDOW,
+    ATOM_NET_CLOSE_WINDOW,
+    ATOM_COUNT
+};
+
+static const char * const ATOM_NAMES[ ATOM_COUNT ] =
+{
+    "WM_STATE",
+    "_NET_WM_STATE",
+    "_NET_WM_STATE_MODAL",
+    "_NET_WM_STATE_HIDDEN",
+    "_NET_WM_WINDOW_TYPE",
+    "_NET_WM_WINDOW_TYPE_NORMAL",
+    "_NET_WM_WINDOW_TYPE_DIALOG",
+    "_NET_WM_NAME",
+    "_NET_WM_PID",
+    "UTF8_STRING",
+    "_NET_CLIENT_LIST",
+    "_NET_ACTIVE_WINDOW",
+    "_NET_CLOSE_WINDOW"
+};
+
+static Atom getAtom( Display *display, X11Atom atom )
+{
+    static Atom atoms[ ATOM_COUNT ];
+    static bool interned = false;
+
+    if ( !interned )
+    {
+        XInternAtoms( display, const_cast<char **>( ATOM_NAMES ), ATOM_COUNT, false, atoms );
+        interned = true;
+    }
+
+    return atoms[ atom ];
+}
+
 /*
  * Assert validity of the window id. Get window attributes for the heck of it
  * and see if the request went through.
@@ -39,12 +92,12 @@ static bool isNormalWindow(Display *display, Window w) {
     unsigned long nitems;
     Window transient_for = None;
 
-    static Atom wmState      = XInternAtom(display, "WM_STATE", false);
-    static Atom windowState  = XInternAtom(display, "_NET_WM_STATE", false);
-    static Atom modalWindow  = XInternAtom(display, "_NET_WM_STATE_MODAL", false);
-    static Atom windowType   = XInternAtom(display, "_NET_WM_WINDOW_TYPE", false);
-    static Atom normalWindow = XInternAtom(display, "_NET_WM_WINDOW_TYPE_NORMAL", false);
-    static Atom dialogWindow = XInternAtom(display, "_NET_WM_WINDOW_TYPE_DIALOG", false);
+    Atom wmState      = getAtom(display, ATOM_WM_STATE);
+    Atom windowState  = getAtom(display, ATOM_NET_WM_STATE);
+    Atom modalWindow  = getAtom(display, ATOM_NET_WM_STATE_MODAL);
+    Atom windowType   = getAtom(display, ATOM_NET_WM_WINDOW_TYPE);
+    Atom normalWindow = getAtom(display, ATOM_NET_WM_WINDOW_TYPE_NORMAL);
+    Atom dialogWindow = getAtom(display, ATOM_NET_WM_WINDOW_TYPE_DIALOG);
 
     int ret = XGetWindowProperty(display, w, wmState, 0, 10, false, AnyPropertyType, &type, &format, &nitems, &left, (unsigned char **) & data);
 
@@ -124,8 +177,8 @@ Window XLibUtil::pidToWid(Display *display, Window window, bool checkNormality,
 static QString getWindowName( Display *display, Window w )
 {
     // Credits: https://stackoverflow.com/questions/8925377/why-is-xgetwindowproperty-returning-null
-    Atom nameAtom = XInternAtom( display, "_NET_WM_NAME", false );
-    Atom utf8Atom = XInternAtom( display, "UTF8_STRING", false );
+    Atom nameAtom = getAtom( display, ATOM_NET_WM_NAME );
+    Atom utf8Atom = getAtom( display, ATOM_UTF8_STRING );
     Atom type;
     int format;
     unsigned long nitems, after;
@@ -215,12 +268,12 @@ static Window findWindow(Display *display, Window window, bool checkNormality, c
 /*
  * Sends ClientMessage to a window.
  */
-static void sendMessage(Display* display, Window to, Window w, const char *type, int format, long mask, void* data, int size) {
+static void sendMessage(Display* display, Window to, Window w, Atom type, int format, long mask, void* data, int size) {
     XEvent ev;
     memset(&ev, 0, sizeof (ev));
     ev.xclient.type = ClientMessage;
     ev.xclient.window = w;
-    ev.xclient.message_type = XInternAtom(display, type, true);
+    ev.xclient.message_type = type;
     ev.xclient.format = format;
     memcpy((char *) & ev.xclient.data, (const char *) data, size);
     XSendEvent(display, to, false, mask, &ev);
@@ -228,10 +281,11 @@ static void sendMessage(Display* display, Window to, Window w, const char *type,
 }
 
 /*
- * Returns the id of the currently active window.
+ * Returns the id of the currently active window. fromProperty is set to true
+ * if it was reported by the window manager in _NET_ACTIVE_WINDOW.
  */
-static Window activeWindow(Display * display) {
-    Atom active_window_atom = XInternAtom(display, "_NET_ACTIVE_WINDOW", true);
+static Window activeWindow(Display * display, bool * fromProperty = nullptr) {
+    Atom active_window_atom = getAtom(display, ATOM_NET_ACTIVE_WINDOW);
     Atom type = None;
     int format;
     unsigned long nitems, after;
@@ -242,6 +296,9 @@ static Window activeWindow(Display * display) {
     int r = XGetWindowProperty(display, root, active_window_atom, 0, 1, false, AnyPropertyType, &type, &format, &nitems, &after, &data);
 
     Window w = None;
+    if (fromProperty) {
+        *fromProperty = (r == Success) && type != None;
+    }
     if ((r == Success) && data && (*reinterpret_cast<Window *> (data) != None)) {
         w = *(Window *) data;
     } else {
@@ -284,10 +341,9 @@ static bool disableCloseButton( Display * display, Window w )
 }
 */
 
-static bool checkWindowState( Display * display, Window w, const char * state )
+static bool checkWindowState( Display * display, Window w, Atom atomstate )
 {
-    static Atom windowState  = XInternAtom( display, "_NET_WM_STATE", false );
-    static Atom atomstate = XInternAtom( display, state, false );
+    Atom windowState = getAtom( display, ATOM_NET_WM_STATE );
     Atom type = None;
     int format;
     unsigned long nitems, after;
@@ -312,7 +368,6 @@ static bool checkWindowState( Display * display, Window w, const char * state )
     return false;
 }
 
-#if 0
 /*
  * Have events associated with mask for the window set in the X11 Event loop
  * to the application.
@@ -327,11 +382,14 @@ static void subscribe(Display *display, Window w, long mask) {
     XSync(display, false);
 }
 
+#if 0
 static void unSubscribe(Display *display, Window w) {
     XSelectInput(display, w, NoEventMask);
     XSync(display, false);
 }
 
+#endif
+
 /*
  * Sets data to the value of the requested window property.
  */
@@ -350,7 +408,55 @@ static bool getCardinalProperty(Display *display, Window w, Atom prop, long *dat
     }
     return false;
 }
-#endif
+
+/*
+ * Searches the windows managed by the window manager, as listed in _NET_CLIENT_LIST of the root
+ * window, for a normal window that matches the ename. If pid is known, the windows of that
+ * process are preferred. Returns false if the window manager doesn't provide the list.
+ */
+static bool findClientWindow(Display *display, Window root, const QString &ename, qint64 pid, Window &found)
+{
+    Atom type;
+    int format;
+    unsigned long nitems, after;
+    unsigned char *data = NULL;
+
+    found = None;
+
+    int r = XGetWindowProperty(display, root, getAtom(display, ATOM_NET_CLIENT_LIST), 0, 65536, false, XA_WINDOW, &type, &format, &nitems, &after, &data);
+
+    if (r != Success || type != XA_WINDOW) {
+        if (r == Success && data) {
+            XFree(data);
+        }
+        return false;
+    }
+
+    Window *clients = reinterpret_cast<Window *> (data);
+
+    for (unsigned long i = 0; i < nitems; i++) {
+        if (!analyzeWindow(display, clients[i], ename) || !isNormalWindow(display, clients[i])) {
+            continue;
+        }
+
+        long windowPid = 0;
+        if (pid == 0 || (getCardinalProperty(display, clients[i], getAtom(display, ATOM_NET_WM_PID), &windowPid)
+                         && windowPid == pid)) {
+            found = clients[i];
+            break;
+        }
+
+        // Not our process, Betterbird might have been started before or by a wrapper script
+        if (found == None) {
+            found = clients[i];
+        }
+    }
+
+    if (data) {
+        XFree(data);
+    }
+    return true;
+}
 
 
 WindowTools_X11::WindowTools_X11()
@@ -358,14 +464,33 @@ WindowTools_X11::WindowTools_X11()
 {  
     mWinId = None;
     mHiddenStateCounter = 0;
+    mActiveWindowTracked = false;
+    mActiveWindow = None;
+    mAtomWindowState = None;
+    mAtomActiveWindow = None;
+    mAtomClientList = None;
 
-    connect( &mWindowStateTimer, &QTimer::timeout, this, &WindowTools_X11::timerWindowState );
-    mWindowStateTimer.setInterval( 250 );
-    mWindowStateTimer.start();
+    Display *display = QX11Info::display();
+
+    if ( !display || QX11Info::appRootWindow() == 0 )
+        return;
+
+    mAtomWindowState = getAtom( display, ATOM_NET_WM_STATE );
+    mAtomActiveWindow = getAtom( display, ATOM_NET_ACTIVE_WINDOW );
+    mAtomClientList = getAtom( display, ATOM_NET_CLIENT_LIST );
+
+    // Get notified about the property changes of the root window (the active window and the list
+    // of managed windows), and the windows which are mapped, so we know when to search again
+    QCoreApplication::instance()->installNativeEventFilter( this );
+    subscribe( display, QX11Info::appRootWindow(), PropertyChangeMask | SubstructureNotifyMask );
+
+    mActiveWindow = activeWindow( display, &mActiveWindowTracked );
 }
 
 WindowTools_X11::~WindowTools_X11()
 {
+    if ( QCoreApplication::instance() )
+        QCoreApplication::instance()->removeNativeEventFilter( this );
 }
 
 bool WindowTools_X11::lookup()
@@ -376,12 +501,37 @@ bool WindowTools_X11::lookup()
     if ( isValid() )
         return true;
 
-    mWinId = findWindow(QX11Info::display(), QX11Info::appRootWindow(), ! BirdtrayApp::get()->getSettings()->mIgnoreNETWMhints,
-            BirdtrayApp::get()->getSettings()->mBetterbirdWindowMatch);
+    const QString &match = BirdtrayApp::get()->getSettings()->mBetterbirdWindowMatch;
 
-    Log::debug("Window ID found: %lX", mWinId );
+    // Nothing changed since the last search, which was a moment ago
+    if ( !startLookup() )
+        return false;
 
-    return mWinId != None;
+    Display *display = QX11Info::display();
+    bool ignoreNETWMhints = BirdtrayApp::get()->getSettings()->mIgnoreNETWMhints;
+
+    // Searching the managed windows is a lot cheaper than walking the whole window tree
+    if ( ignoreNETWMhints || !findClientWindow( display, QX11Info::appRootWindow(), match, mProcessId, mWinId ) )
+        mWinId = findWindow(display, QX11Info::appRootWindow(), !ignoreNETWMhints, match);
+
+    LOG_INFO("Window ID found: %lX", mWinId );
+
+    if ( mWinId == None )
+        return false;
+
+    // Get notified when the window state changes or the window is destroyed.
+    // Check the window afterwards, as it could have been destroyed before we subscribed.
+    subscribe( display, mWinId, PropertyChangeMask | StructureNotifyMask );
+
+    if ( !isValidWindowId( display, mWinId ) )
+    {
+        mWinId = None;
+        requestLookup();
+        return false;
+    }
+
+    checkWindowMinimized();
+    return true;
 }
 
 bool WindowTools_X11::show()
@@ -410,7 +560,7 @@ bool WindowTools_X11::show()
     // 1 == request sent from application. 2 == from pager.
     // We use 2 because KWin doesn't always give the window focus with 1.
     long l_active[2] = {2, CurrentTime};
-    sendMessage( display, root, mWinId, "_NET_ACTIVE_WINDOW", 32, SubstructureNotifyMask | SubstructureRedirectMask, l_active, sizeof (l_active) );
+    sendMessage( display, root, mWinId, getAtom( display, ATOM_NET_ACTIVE_WINDOW ), 32, SubstructureNotifyMask | SubstructureRedirectMask, l_active, sizeof (l_active) );
     XSetInputFocus(display, mWinId, RevertToParent, CurrentTime);
 
     mHiddenStateCounter = 0;
@@ -425,7 +575,7 @@ bool WindowTools_X11::hide()
 
     if ( mHiddenStateCounter != 0 )
     {
-        Log::debug("Warning: trying to hide already hidden window (counter %d), ignored", mHiddenStateCounter );
+        LOG_WARNING("Warning: trying to hide already hidden window (counter %d), ignored", mHiddenStateCounter );
         return false;
     }
 
@@ -444,7 +594,10 @@ bool WindowTools_X11::hide()
 
 bool WindowTools_X11::isHidden()
 {
-    return mHiddenStateCounter == 2 && mWinId != activeWindow( QX11Info::display() );
+    if ( mHiddenStateCounter != 2 )
+        return false;
+
+    return mWinId != ( mActiveWindowTracked ? mActiveWindow : activeWindow( QX11Info::display() ) );
 }
 
 bool WindowTools_X11::closeWindow()
@@ -456,13 +609,71 @@ bool WindowTools_X11::closeWindow()
 
     // send _NET_CLOSE_WINDOW
     long l[5] = {0, 0, 0, 0, 0};
-    sendMessage( QX11Info::display(), QX11Info::appRootWindow(), mWinId, "_NET_CLOSE_WINDOW", 32, SubstructureNotifyMask | SubstructureRedirectMask, l, sizeof (l));
+    sendMessage( QX11Info::display(), QX11Info::appRootWindow(), mWinId, getAtom( QX11Info::display(), ATOM_NET_CLOSE_WINDOW ), 32, SubstructureNotifyMask | SubstructureRedirectMask, l, sizeof (l));
     return true;
 }
 
 bool WindowTools_X11::isValid()
 {
-    return mWinId != None && isValidWindowId( QX11Info::display(), mWinId );
+    // The window ID is reset when the window is destroyed
+    return mWinId != None;
+}
+
+bool WindowTools_X11::nativeEventFilter( const QByteArray &eventType, void *message, long * )
+{
+    if ( eventType != "xcb_generic_event_t" )
+        return false;
+
+    xcb_generic_event_t * event = static_cast<xcb_generic_event_t *>( message );
+
+    switch ( event->response_type & ~0x80 )
+    {
+        case XCB_PROPERTY_NOTIFY:
+        {
+            xcb_property_notify_event_t * ev = reinterpret_cast<xcb_property_notify_event_t *>( event );
+
+            if ( ev->window == QX11Info::appRootWindow() )
+            {
+                if ( ev->atom == mAtomActiveWindow )
+                    mActiveWindow = activeWindow( QX11Info::display(), &mActiveWindowTracked );
+                else if ( ev->atom == mAtomClientList )
+                    requestLookup();
+            }
+            else if ( ev->window == mWinId && ev->atom == mAtomWindowState )
+            {
+                checkWindowMinimized();
+            }
+            break;
+        }
+
+        case XCB_MAP_NOTIFY:
+            // A new window may be the one we are looking for
+            if ( mWinId == None )
+                requestLookup();
+            break;
+
+        case XCB_DESTROY_NOTIFY:
+        {
+            xcb_destroy_notify_event_t * ev = reinterpret_cast<xcb_destroy_notify_event_t *>( event );
+
+            if ( mWinId != None && ev->window == mWinId )
+            {
+                LOG_INFO("Window %lX was destroyed", mWinId );
+                mWinId = None;
+
+                // The next Betterbird window starts out visible
+                mHiddenStateCounter = 0;
+                mSizeHint = XSizeHints();
+                requestLookup();
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    return false;
 }
 
 void WindowTools_X11::doHide()
@@ -472,7 +683,7 @@ void WindowTools_X11::doHide()
     // window manager removes the window from an active window. This would result in multiple calls to doHide().
     if ( mHiddenStateCounter == 2 )
     {
-        Log::debug("Window already should be removed from taskbar");
+        LOG_DEBUG("Window already should be removed from taskbar");
         return;
     }
 
@@ -493,19 +704,19 @@ void WindowTools_X11::doHide()
     mHiddenStateCounter++;
 
     if ( mHiddenStateCounter == 2 ) {
-        Log::debug("Window removed from taskbar");
+        LOG_DEBUG("Window removed from taskbar");
         emit onWindowHidden();
     }
 }
 
-void WindowTools_X11::timerWindowState()
+void WindowTools_X11::checkWindowMinimized()
 {
     if (mWinId == None || !BirdtrayApp::get()->getSettings()->mHideWhenMinimized) {
         return;
     }
 
     // _NET_WM_STATE_HIDDEN is set for minimized windows, so if we see it, this means it was minimized by the user
-    if ( checkWindowState( QX11Info::display(), mWinId, "_NET_WM_STATE_HIDDEN" ) && mHiddenStateCounter == 0 )
+    if ( checkWindowState( QX11Info::display(), mWinId, getAtom( QX11Info::display(), ATOM_NET_WM_STATE_HIDDEN ) ) && mHiddenStateCounter == 0 )
     {
         mHiddenStateCounter = 1;
         QTimer::singleShot( 0, this, &WindowTools_X11::doHide );
@@ -514,7 +725,7 @@ void WindowTools_X11::timerWindowState()
 
 bool WindowTools_X11::checkWindow()
 {
-    if ( mWinId == None || !isValidWindowId( QX11Info::display(), mWinId ) )
+    if ( !isValid() )
         return lookup();
 
     return true;
@@ -7,12 +7,16 @@
 #include <QX11Info>
 #include <QRegExp>
 #include <QList>
+#include <QAbstractNativeEventFilter>
 
 #include <X11/Xatom.h>
 #include <X11/Xlib-xcb.h>
 #include <X11/Xutil.h>
 
-class WindowTools_X11 : public WindowTools
+// Tracks the Betterbird window through the X events of the root window and the Betterbird window,
+// so nothing is polled from the X server while the state doesn't change. Only while the window
+// isn't found, it is searched again every few seconds.
+class WindowTools_X11 : public WindowTools, public QAbstractNativeEventFilter
 {
     Q_OBJECT
 
@@ -39,9 +43,14 @@ class WindowTools_X11 : public WindowTools
         // Return true if Betterbird window is valid (hidden or shown)
         virtual bool    isValid();
 
+        // Handles the X events of the root window and the Betterbird window
+        bool    nativeEventFilter( const QByteArray &eventType, void *message, long *result ) override;
+
     private slots:
         void    doHide();
-        void    timerWindowState();
+
+        // Hides the window if it was minimized by the user
+        void    checkWindowMinimized();
 
     private:
         // Makes sure our window ID is still valid, or reinitializes it
@@ -56,8 +65,16 @@ class WindowTools_X11 : public WindowTools
         // State counter
         int         mHiddenStateCounter;
 
-        // State check timer
-        QTimer      mWindowStateTimer;
+        // True if the window manager reports the active window in _NET_ACTIVE_WINDOW,
+        // which is then tracked in mActiveWindow
+        bool        mActiveWindowTracked;
+        Window      mActiveWindow;
+
+
+        // Atoms of the properties we are watching
+        Atom        mAtomWindowState;
+        Atom        mAtomActiveWindow;
+        Atom        mAtomClientList;
 };
 
 #endif // WINDOWTOOLS_X11_H
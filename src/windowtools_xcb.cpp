@@ -0,0 +1,650 @@
+#include <QTimer>
+#include <QCoreApplication>
+#include <QScopedPointer>
+#include <QHash>
+#include <QX11Info>
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+#include "birdtrayapp.h"
+#include "windowtools_xcb.h"
+#include "log.h"
+
+/*
+ * The atoms we use. They are interned once, all requests are sent before the first reply is read.
+ */
+enum XcbAtom
+{
+    ATOM_WM_STATE,
+    ATOM_WM_CHANGE_STATE,
+    ATOM_NET_WM_STATE,
+    ATOM_NET_WM_STATE_MODAL,
+    ATOM_NET_WM_STATE_HIDDEN,
+    ATOM_NET_WM_WINDOW_TYPE,
+    ATOM_NET_WM_WINDOW_TYPE_NORMAL,
+    ATOM_NET_WM_WINDOW_TYPE_DIALOG,
+    ATOM_NET_WM_NAME,
+    ATOM_NET_WM_PID,
+    ATOM_UTF8_STRING,
+    ATOM_NET_CLIENT_LIST,
+    ATOM_NET_ACTIVE_WINDOW,
+    ATOM_NET_CLOSE_WINDOW,
+    ATOM_COUNT
+};
+
+static const char * const ATOM_NAMES[ ATOM_COUNT ] =
+{
+    "WM_STATE",
+    "WM_CHANGE_STATE",
+    "_NET_WM_STATE",
+    "_NET_WM_STATE_MODAL",
+    "_NET_WM_STATE_HIDDEN",
+    "_NET_WM_WINDOW_TYPE",
+    "_NET_WM_WINDOW_TYPE_NORMAL",
+    "_NET_WM_WINDOW_TYPE_DIALOG",
+    "_NET_WM_NAME",
+    "_NET_WM_PID",
+    "UTF8_STRING",
+    "_NET_CLIENT_LIST",
+    "_NET_ACTIVE_WINDOW",
+    "_NET_CLOSE_WINDOW"
+};
+
+// Constants from Xutil.h and X.h, which we don't include here
+static const uint32_t ICONIC_STATE = 3;
+static const uint32_t US_POSITION = 1;
+static const uint32_t SIZE_HINTS_LENGTH = 18;
+
+// The window manager gets the messages to the root window with this mask
+static const uint32_t ROOT_MESSAGE_MASK = XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT;
+
+typedef QScopedPointer<xcb_get_property_reply_t, QScopedPointerPodDeleter> PropertyReply;
+
+/*
+ * Reads the reply of a property request. Returns a null reply if the property doesn't exist.
+ */
+static xcb_get_property_reply_t * propertyReply( xcb_connection_t * connection, xcb_get_property_cookie_t cookie )
+{
+    xcb_get_property_reply_t * reply = xcb_get_property_reply( connection, cookie, nullptr );
+
+    if ( reply && reply->type == XCB_ATOM_NONE )
+    {
+        free( reply );
+        return nullptr;
+    }
+
+    return reply;
+}
+
+/*
+ * Returns the values of a property with 32 bit format (atoms, windows and cardinals).
+ */
+static QVector<uint32_t> propertyValues( const xcb_get_property_reply_t * reply )
+{
+    QVector<uint32_t> values;
+
+    if ( !reply || reply->format != 32 )
+        return values;
+
+    const uint32_t * data = static_cast<const uint32_t *>( xcb_get_property_value( reply ) );
+    int count = xcb_get_property_value_length( reply ) / 4;
+
+    for ( int i = 0; i < count; i++ )
+        values.append( data[i] );
+
+    return values;
+}
+
+/*
+ * Returns the string of a property with 8 bit format.
+ */
+static QByteArray propertyString( const xcb_get_property_reply_t * reply )
+{
+    if ( !reply || reply->format != 8 )
+        return QByteArray();
+
+    return QByteArray( static_cast<const char *>( xcb_get_property_value( reply ) ),
+                       xcb_get_property_value_length( reply ) );
+}
+
+WindowTools_Xcb::WindowTools_Xcb()
+    : WindowTools()
+{
+    mConnection = QX11Info::connection();
+    mRoot = static_cast<xcb_window_t>( QX11Info::appRootWindow() );
+    mWinId = XCB_WINDOW_NONE;
+    mHiddenStateCounter = 0;
+    mActiveWindowTracked = false;
+    mActiveWindow = XCB_WINDOW_NONE;
+    mActiveWindowRequested = false;
+    mAtoms.fill( XCB_ATOM_NONE, ATOM_COUNT );
+
+    if ( !mConnection || mRoot == XCB_WINDOW_NONE )
+        return;
+
+    xcb_intern_atom_cookie_t cookies[ ATOM_COUNT ];
+
+    for ( int i = 0; i < ATOM_COUNT; i++ )
+        cookies[i] = xcb_intern_atom( mConnection, false, static_cast<uint16_t>( strlen( ATOM_NAMES[i] ) ), ATOM_NAMES[i] );
+
+    for ( int i = 0; i < ATOM_COUNT; i++ )
+    {
+        xcb_intern_atom_reply_t * reply = xcb_intern_atom_reply( mConnection, cookies[i], nullptr );
+
+        if ( reply )
+        {
+            mAtoms[i] = reply->atom;
+            free( reply );
+        }
+    }
+
+    // Get notified about the property changes of the root window (the active window and the list
+    // of managed windows), and the windows which are mapped, so we know when to search again
+    QCoreApplication::instance()->installNativeEventFilter( this );
+    subscribe( mRoot, XCB_EVENT_MASK_PROPERTY_CHANGE | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY );
+
+    requestActiveWindow();
+}
+
+WindowTools_Xcb::~WindowTools_Xcb()
+{
+    if ( QCoreApplication::instance() )
+        QCoreApplication::instance()->removeNativeEventFilter( this );
+
+    if ( mActiveWindowRequested )
+        xcb_discard_reply( mConnection, mActiveWindowCookie.sequence );
+}
+
+bool WindowTools_Xcb::lookup()
+{
+    if ( !mConnection || mRoot == XCB_WINDOW_NONE )
+        return false;
+
+    if ( isValid() )
+        return true;
+
+    const QString &match = BirdtrayApp::get()->getSettings()->mBetterbirdWindowMatch;
+
+    // Nothing changed since the last search, which was a moment ago
+    if ( !startLookup() )
+        return false;
+
+
+    bool ignoreNETWMhints = BirdtrayApp::get()->getSettings()->mIgnoreNETWMhints;
+
+    // Searching the managed windows is a lot cheaper than walking the whole window tree
+    if ( ignoreNETWMhints || !findClientWindow( match, mWinId ) )
+        mWinId = findWindowInTree( match, !ignoreNETWMhints );
+
+    LOG_INFO("Window ID found: %X", mWinId );
+
+    if ( mWinId == XCB_WINDOW_NONE )
+        return false;
+
+    // Get notified when the window state changes or the window is destroyed.
+    // Check the window afterwards, as it could have been destroyed before we subscribed.
+    subscribe( mWinId, XCB_EVENT_MASK_PROPERTY_CHANGE | XCB_EVENT_MASK_STRUCTURE_NOTIFY );
+
+    xcb_get_window_attributes_reply_t * attributes = xcb_get_window_attributes_reply(
+            mConnection, xcb_get_window_attributes( mConnection, mWinId ), nullptr );
+
+    if ( !attributes )
+    {
+        mWinId = XCB_WINDOW_NONE;
+        requestLookup();
+        return false;
+    }
+
+    free( attributes );
+    checkWindowMinimized();
+    return true;
+}
+
+bool WindowTools_Xcb::show()
+{
+    if ( !checkWindow() )
+        return false;
+
+    // We are still minimizing
+    if ( mHiddenStateCounter == 1 )
+        return false;
+
+    if ( mHiddenStateCounter == 2 )
+    {
+        xcb_map_window( mConnection, mWinId );
+
+        if ( !mSizeHints.isEmpty() )
+        {
+            mSizeHints[0] = US_POSITION;
+            xcb_change_property( mConnection, XCB_PROP_MODE_REPLACE, mWinId, XCB_ATOM_WM_NORMAL_HINTS,
+                                 XCB_ATOM_WM_SIZE_HINTS, 32, mSizeHints.size(), mSizeHints.constData() );
+        }
+    }
+
+    const uint32_t stackMode = XCB_STACK_MODE_ABOVE;
+    xcb_configure_window( mConnection, mWinId, XCB_CONFIG_WINDOW_STACK_MODE, &stackMode );
+    xcb_map_window( mConnection, mWinId );
+
+    // Make it the active window
+    // 1 == request sent from application. 2 == from pager.
+    // We use 2 because KWin doesn't always give the window focus with 1.
+    sendRootMessage( mWinId, mAtoms[ ATOM_NET_ACTIVE_WINDOW ], 2, XCB_CURRENT_TIME );
+    xcb_set_input_focus( mConnection, XCB_INPUT_FOCUS_PARENT, mWinId, XCB_CURRENT_TIME );
+    xcb_flush( mConnection );
+
+    mHiddenStateCounter = 0;
+    emit onWindowShown();
+    return true;
+}
+
+bool WindowTools_Xcb::hide()
+{
+    if ( !checkWindow() )
+        return false;
+
+    if ( mHiddenStateCounter != 0 )
+    {
+        LOG_WARNING("Warning: trying to hide already hidden window (counter %d), ignored", mHiddenStateCounter );
+        return false;
+    }
+
+    PropertyReply hints( propertyReply( mConnection, xcb_get_property(
+            mConnection, false, mWinId, XCB_ATOM_WM_NORMAL_HINTS, XCB_ATOM_WM_SIZE_HINTS, 0, SIZE_HINTS_LENGTH ) ) );
+
+    mSizeHints = propertyValues( hints.data() );
+
+    if ( !mSizeHints.isEmpty() )
+        mSizeHints.resize( SIZE_HINTS_LENGTH );
+
+    // We call doHide() twice - at first call kWin only minimizes it,
+    // and only the second call actually hides the window from the taskbar.
+    QTimer::singleShot( 0, this, &WindowTools_Xcb::doHide );
+    QTimer::singleShot( 0, this, &WindowTools_Xcb::doHide );
+    return true;
+}
+
+bool WindowTools_Xcb::isHidden()
+{
+    if ( mHiddenStateCounter != 2 )
+        return false;
+
+    return mWinId != activeWindow();
+}
+
+bool WindowTools_Xcb::closeWindow()
+{
+    if ( !checkWindow() )
+        return false;
+
+    show();
+
+    // send _NET_CLOSE_WINDOW
+    sendRootMessage( mWinId, mAtoms[ ATOM_NET_CLOSE_WINDOW ], 0 );
+    xcb_flush( mConnection );
+    return true;
+}
+
+bool WindowTools_Xcb::isValid()
+{
+    // The window ID is reset when the window is destroyed
+    return mWinId != XCB_WINDOW_NONE;
+}
+
+bool WindowTools_Xcb::nativeEventFilter( const QByteArray &eventType, void *message, long * )
+{
+    if ( eventType != "xcb_generic_event_t" )
+        return false;
+
+    xcb_generic_event_t * event = static_cast<xcb_generic_event_t *>( message );
+
+    switch ( event->response_type & ~0x80 )
+    {
+        case XCB_PROPERTY_NOTIFY:
+        {
+            xcb_property_notify_event_t * ev = reinterpret_cast<xcb_property_notify_event_t *>( event );
+
+            if ( ev->window == mRoot )
+            {
+                if ( ev->atom == mAtoms[ ATOM_NET_ACTIVE_WINDOW ] )
+                    requestActiveWindow();
+                else if ( ev->atom == mAtoms[ ATOM_NET_CLIENT_LIST ] )
+                    requestLookup();
+            }
+            else if ( ev->window == mWinId && ev->atom == mAtoms[ ATOM_NET_WM_STATE ] )
+            {
+                checkWindowMinimized();
+            }
+            break;
+        }
+
+        case XCB_MAP_NOTIFY:
+            // A new window may be the one we are looking for
+            if ( mWinId == XCB_WINDOW_NONE )
+                requestLookup();
+            break;
+
+        case XCB_DESTROY_NOTIFY:
+        {
+            xcb_destroy_notify_event_t * ev = reinterpret_cast<xcb_destroy_notify_event_t *>( event );
+
+            if ( mWinId != XCB_WINDOW_NONE && ev->window == mWinId )
+            {
+                LOG_INFO("Window %X was destroyed", mWinId );
+                mWinId = XCB_WINDOW_NONE;
+
+                // The next Betterbird window starts out visible
+                mHiddenStateCounter = 0;
+                mSizeHints.clear();
+                requestLookup();
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    return false;
+}
+
+void WindowTools_Xcb::doHide()
+{
+    // This function may end up being called more than two times because isHidden() not only checks the counter,
+    // but also checks the active window. Depending on window manager, the counter may get to 2 much faster than
+    // window manager removes the window from an active window. This would result in multiple calls to doHide().
+    if ( mHiddenStateCounter == 2 )
+    {
+        LOG_DEBUG("Window already should be removed from taskbar");
+        return;
+    }
+
+    /*
+     * Same as XIconifyWindow and XWithdrawWindow:
+     * 1. Iconify. This will make the application hide all its other windows.
+     * 2. Withdraw the window to remove it from the taskbar: unmap it, and tell
+     *    the window manager with a synthetic UnmapNotify, as ICCCM requires.
+     */
+    sendRootMessage( mWinId, mAtoms[ ATOM_WM_CHANGE_STATE ], ICONIC_STATE );
+    xcb_unmap_window( mConnection, mWinId );
+
+    char buffer[32];
+    memset( buffer, 0, sizeof( buffer ) );
+    xcb_unmap_notify_event_t * unmap = reinterpret_cast<xcb_unmap_notify_event_t *>( buffer );
+    unmap->response_type = XCB_UNMAP_NOTIFY;
+    unmap->event = mRoot;
+    unmap->window = mWinId;
+    unmap->from_configure = false;
+    xcb_send_event( mConnection, false, mRoot, ROOT_MESSAGE_MASK, buffer );
+    xcb_flush( mConnection );
+
+    // Increase the counter but do not exceed 2
+    mHiddenStateCounter++;
+
+    if ( mHiddenStateCounter == 2 ) {
+        LOG_DEBUG("Window removed from taskbar");
+        emit onWindowHidden();
+    }
+}
+
+void WindowTools_Xcb::checkWindowMinimized()
+{
+    if ( mWinId == XCB_WINDOW_NONE || !BirdtrayApp::get()->getSettings()->mHideWhenMinimized )
+        return;
+
+    PropertyReply state( propertyReply( mConnection, xcb_get_property(
+            mConnection, false, mWinId, mAtoms[ ATOM_NET_WM_STATE ], XCB_ATOM_ANY, 0, 10 ) ) );
+
+    // _NET_WM_STATE_HIDDEN is set for minimized windows, so if we see it, this means it was minimized by the user
+    if ( propertyValues( state.data() ).contains( mAtoms[ ATOM_NET_WM_STATE_HIDDEN ] ) && mHiddenStateCounter == 0 )
+    {
+        mHiddenStateCounter = 1;
+        QTimer::singleShot( 0, this, &WindowTools_Xcb::doHide );
+    }
+}
+
+bool WindowTools_Xcb::checkWindow()
+{
+    if ( !isValid() )
+        return lookup();
+
+    return true;
+}
+
+void WindowTools_Xcb::subscribe( xcb_window_t window, uint32_t mask )
+{
+    xcb_get_window_attributes_reply_t * attributes = xcb_get_window_attributes_reply(
+            mConnection, xcb_get_window_attributes( mConnection, window ), nullptr );
+
+    if ( !attributes )
+        return;
+
+    uint32_t eventMask = attributes->your_event_mask | mask;
+    free( attributes );
+
+    xcb_change_window_attributes( mConnection, window, XCB_CW_EVENT_MASK, &eventMask );
+    xcb_flush( mConnection );
+}
+
+QVector<xcb_window_t> WindowTools_Xcb::matchWindows( const QVector<xcb_window_t> &windows, const QString &match,
+                                                     bool checkNormality, QVector<uint32_t> * pids )
+{
+    QVector<xcb_window_t> matching;
+    QVector<xcb_get_property_cookie_t> classCookies;
+    QVector<xcb_get_property_cookie_t> nameCookies;
+
+    // Request the class and the name of all windows, before reading the first reply
+    for ( xcb_window_t window : windows )
+    {
+        classCookies.append( xcb_get_property( mConnection, false, window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, 256 ) );
+        nameCookies.append( xcb_get_property( mConnection, false, window, mAtoms[ ATOM_NET_WM_NAME ], mAtoms[ ATOM_UTF8_STRING ], 0, 65536 ) );
+    }
+
+    for ( int i = 0; i < windows.size(); i++ )
+    {
+        PropertyReply wmClass( propertyReply( mConnection, classCookies[i] ) );
+        PropertyReply name( propertyReply( mConnection, nameCookies[i] ) );
+
+        // The class contains the instance name and the class name, we try both of them,
+        // and the window name in sheer desperation
+        if ( !wmClass )
+            continue;
+
+        QList<QByteArray> names = propertyString( wmClass.data() ).split( '\0' );
+
+        if ( QString::fromUtf8( names.value( 0 ) ).endsWith( match )
+             || QString::fromUtf8( names.value( 1 ) ).endsWith( match )
+             || QString::fromUtf8( propertyString( name.data() ) ).endsWith( match ) )
+        {
+            matching.append( windows[i] );
+        }
+    }
+
+    if ( !checkNormality && !pids )
+        return matching;
+
+    // Request all properties which tell if this is a normal window, and the process IDs
+    QVector<xcb_get_property_cookie_t> cookies;
+
+    for ( xcb_window_t window : matching )
+    {
+        cookies.append( xcb_get_property( mConnection, false, window, mAtoms[ ATOM_WM_STATE ], XCB_ATOM_ANY, 0, 10 ) );
+        cookies.append( xcb_get_property( mConnection, false, window, mAtoms[ ATOM_NET_WM_STATE ], XCB_ATOM_ANY, 0, 10 ) );
+        cookies.append( xcb_get_property( mConnection, false, window, mAtoms[ ATOM_NET_WM_WINDOW_TYPE ], XCB_ATOM_ANY, 0, 10 ) );
+        cookies.append( xcb_get_property( mConnection, false, window, XCB_ATOM_WM_TRANSIENT_FOR, XCB_ATOM_WINDOW, 0, 1 ) );
+        cookies.append( xcb_get_property( mConnection, false, window, mAtoms[ ATOM_NET_WM_PID ], XCB_ATOM_CARDINAL, 0, 1 ) );
+    }
+
+    QVector<xcb_window_t> normal;
+
+    for ( int i = 0; i < matching.size(); i++ )
+    {
+        PropertyReply wmState( propertyReply( mConnection, cookies[ i * 5 ] ) );
+        PropertyReply netWmState( propertyReply( mConnection, cookies[ i * 5 + 1 ] ) );
+        PropertyReply windowType( propertyReply( mConnection, cookies[ i * 5 + 2 ] ) );
+        PropertyReply transientFor( propertyReply( mConnection, cookies[ i * 5 + 3 ] ) );
+        PropertyReply pid( propertyReply( mConnection, cookies[ i * 5 + 4 ] ) );
+
+        if ( checkNormality )
+        {
+            // Not managed by the window manager, or a modal window
+            if ( !wmState || propertyValues( netWmState.data() ).contains( mAtoms[ ATOM_NET_WM_STATE_MODAL ] ) )
+                continue;
+
+            // Only normal windows and dialogs, or windows which are not transient if the type is not set
+            if ( !windowType.isNull() )
+            {
+                bool normalType = true;
+
+                for ( uint32_t type : propertyValues( windowType.data() ) )
+                {
+                    if ( type != mAtoms[ ATOM_NET_WM_WINDOW_TYPE_NORMAL ] && type != mAtoms[ ATOM_NET_WM_WINDOW_TYPE_DIALOG ] )
+                        normalType = false;
+                }
+
+                if ( !normalType )
+                    continue;
+            }
+            else if ( propertyValues( transientFor.data() ).value( 0, XCB_WINDOW_NONE ) != XCB_WINDOW_NONE )
+            {
+                continue;
+            }
+        }
+
+        normal.append( matching[i] );
+
+        if ( pids )
+            pids->append( propertyValues( pid.data() ).value( 0, 0 ) );
+    }
+
+    return normal;
+}
+
+bool WindowTools_Xcb::findClientWindow( const QString &match, xcb_window_t &found )
+{
+    found = XCB_WINDOW_NONE;
+
+    PropertyReply clientList( propertyReply( mConnection, xcb_get_property(
+            mConnection, false, mRoot, mAtoms[ ATOM_NET_CLIENT_LIST ], XCB_ATOM_WINDOW, 0, 65536 ) ) );
+
+    if ( !clientList || clientList->type != XCB_ATOM_WINDOW )
+        return false;
+
+    QVector<xcb_window_t> clients = propertyValues( clientList.data() );
+    QVector<uint32_t> pids;
+    QVector<xcb_window_t> matching = matchWindows( clients, match, true, &pids );
+
+    if ( matching.isEmpty() )
+        return true;
+
+    // Prefer the window of our process. Betterbird might have been started before,
+    // or by a wrapper script, so any matching window is used otherwise.
+    int index = mProcessId != 0 ? pids.indexOf( static_cast<uint32_t>( mProcessId ) ) : -1;
+    found = matching[ index != -1 ? index : 0 ];
+    return true;
+}
+
+xcb_window_t WindowTools_Xcb::findWindowInTree( const QString &match, bool checkNormality )
+{
+    QHash<xcb_window_t, QVector<xcb_window_t>> children;
+    QVector<xcb_window_t> level;
+    level.append( mRoot );
+
+    // Query the tree one level at a time, with the requests of a level sent at once
+    while ( !level.isEmpty() )
+    {
+        QVector<xcb_query_tree_cookie_t> cookies;
+
+        for ( xcb_window_t window : level )
+            cookies.append( xcb_query_tree( mConnection, window ) );
+
+        QVector<xcb_window_t> nextLevel;
+
+        for ( int i = 0; i < level.size(); i++ )
+        {
+            xcb_query_tree_reply_t * reply = xcb_query_tree_reply( mConnection, cookies[i], nullptr );
+
+            if ( !reply )
+                continue;
+
+            const xcb_window_t * windows = xcb_query_tree_children( reply );
+            QVector<xcb_window_t> &list = children[ level[i] ];
+
+            for ( int c = 0; c < xcb_query_tree_children_length( reply ); c++ )
+                list.append( windows[c] );
+
+            nextLevel += list;
+            free( reply );
+        }
+
+        level = nextLevel;
+    }
+
+    // Order the windows like the recursive search does: each window comes before its children
+    QVector<xcb_window_t> ordered;
+    QVector<xcb_window_t> stack = children.value( mRoot );
+    std::reverse( stack.begin(), stack.end() );
+
+    while ( !stack.isEmpty() )
+    {
+        xcb_window_t window = stack.takeLast();
+        ordered.append( window );
+
+        const QVector<xcb_window_t> &list = children[ window ];
+
+        for ( int i = list.size() - 1; i >= 0; i-- )
+            stack.append( list[i] );
+    }
+
+    return matchWindows( ordered, match, checkNormality ).value( 0, XCB_WINDOW_NONE );
+}
+
+void WindowTools_Xcb::sendRootMessage( xcb_window_t window, xcb_atom_t type, uint32_t data0, uint32_t data1 )
+{
+    xcb_client_message_event_t event;
+    memset( &event, 0, sizeof( event ) );
+    event.response_type = XCB_CLIENT_MESSAGE;
+    event.format = 32;
+    event.window = window;
+    event.type = type;
+    event.data.data32[0] = data0;
+    event.data.data32[1] = data1;
+
+    xcb_send_event( mConnection, false, mRoot, ROOT_MESSAGE_MASK, reinterpret_cast<const char *>( &event ) );
+}
+
+void WindowTools_Xcb::requestActiveWindow()
+{
+    if ( mActiveWindowRequested )
+        xcb_discard_reply( mConnection, mActiveWindowCookie.sequence );
+
+    mActiveWindowCookie = xcb_get_property( mConnection, false, mRoot, mAtoms[ ATOM_NET_ACTIVE_WINDOW ], XCB_ATOM_ANY, 0, 1 );
+    mActiveWindowRequested = true;
+    xcb_flush( mConnection );
+}
+
+xcb_window_t WindowTools_Xcb::activeWindow()
+{
+    if ( mActiveWindowRequested )
+    {
+        PropertyReply reply( propertyReply( mConnection, mActiveWindowCookie ) );
+        mActiveWindowRequested = false;
+        mActiveWindowTracked = !reply.isNull();
+        mActiveWindow = propertyValues( reply.data() ).value( 0, XCB_WINDOW_NONE );
+    }
+
+    if ( mActiveWindowTracked && mActiveWindow != XCB_WINDOW_NONE )
+        return mActiveWindow;
+
+    // The window manager doesn't tell, so use the input focus
+    xcb_get_input_focus_reply_t * focus = xcb_get_input_focus_reply(
+            mConnection, xcb_get_input_focus( mConnection ), nullptr );
+
+    if ( !focus )
+        return XCB_WINDOW_NONE;
+
+    xcb_window_t window = focus->focus;
+    free( focus );
+    return window;
+}
@@ -0,0 +1,105 @@
+#ifndef WINDOWTOOLS_XCB_H
+#define WINDOWTOOLS_XCB_H
+
+#include "windowtools.h"
+
+#include <QVector>
+#include <QString>
+#include <QAbstractNativeEventFilter>
+
+#include <xcb/xcb.h>
+
+// Same as WindowTools_X11, but written on xcb. The requests are pipelined: all properties
+// needed to match a list of windows are requested in one batch before the first reply is read,
+// and nothing waits for the X server to process the requests which don't have a reply.
+class WindowTools_Xcb : public WindowTools, public QAbstractNativeEventFilter
+{
+    Q_OBJECT
+
+    public:
+        WindowTools_Xcb();
+        ~WindowTools_Xcb();
+
+        // Looks up and remembers Betterbird window handle. Returns true if found,
+        // false if not found.
+        virtual bool    lookup();
+
+        // Shows/activates the window
+        virtual bool    show();
+
+        // Hides/closes the window (without closing the process)
+        virtual bool    hide();
+
+        // Whether window is hidden or not
+        virtual bool    isHidden();
+
+        // Closes the application via WM_CLOSE or similar
+        virtual bool    closeWindow();
+
+        // Return true if Betterbird window is valid (hidden or shown)
+        virtual bool    isValid();
+
+        // Handles the X events of the root window and the Betterbird window
+        bool    nativeEventFilter( const QByteArray &eventType, void *message, long *result ) override;
+
+    private slots:
+        void    doHide();
+
+        // Hides the window if it was minimized by the user
+        void    checkWindowMinimized();
+
+    private:
+        // Makes sure our window ID is still valid, or reinitializes it
+        bool    checkWindow();
+
+        // Adds the events in mask to the events we get for the window
+        void    subscribe( xcb_window_t window, uint32_t mask );
+
+        // Returns the windows of the list which match the window match setting, in the same order.
+        // If pids is not null, it receives the _NET_WM_PID of the matching windows.
+        QVector<xcb_window_t> matchWindows( const QVector<xcb_window_t> &windows, const QString &match,
+                                            bool checkNormality, QVector<uint32_t> * pids = nullptr );
+
+        // Searches the windows in _NET_CLIENT_LIST, returns false if there is no such list
+        bool    findClientWindow( const QString &match, xcb_window_t &found );
+
+        // Searches the whole window tree, in the same order as WindowTools_X11
+        xcb_window_t findWindowInTree( const QString &match, bool checkNormality );
+
+        // Sends a client message to the root window, like the window manager expects it
+        void    sendRootMessage( xcb_window_t window, xcb_atom_t type, uint32_t data0, uint32_t data1 = 0 );
+
+        // Requests the currently active window, the reply is read when it's needed
+        void    requestActiveWindow();
+
+        // Returns the currently active window
+        xcb_window_t activeWindow();
+
+        // The connection Qt uses, and the root window
+        xcb_connection_t * mConnection;
+        xcb_window_t    mRoot;
+
+        // Our Window ID
+        xcb_window_t    mWinId;
+
+        // Size hints of the window while it is hidden
+        QVector<uint32_t> mSizeHints;
+
+        // State counter
+        int             mHiddenStateCounter;
+
+        // True if the window manager reports the active window in _NET_ACTIVE_WINDOW,
+        // which is then tracked in mActiveWindow
+        bool            mActiveWindowTracked;
+        xcb_window_t    mActiveWindow;
+
+        // The pending request of _NET_ACTIVE_WINDOW, if mActiveWindowRequested is true
+        bool            mActiveWindowRequested;
+        xcb_get_property_cookie_t mActiveWindowCookie;
+
+
+        // The interned atoms, indexed by the atom enum in the source
+        QVector<xcb_atom_t> mAtoms;
+};
+
+#endif // WINDOWTOOLS_XCB_H
@@ -0,0 +1,46 @@
+#include "AllocationCounter.h"
+#include <atomic>
+
+#ifdef __GLIBC__
+#  include <cstddef>
+
+static std::atomic<quint64> allocationCount(0);
+
+// Every allocation of the process goes through these, they count it and use the glibc allocator.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+
+void* malloc(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+}
+#endif /* __GLIBC__ */
+
+bool AllocationCounter::isSupported() {
+#ifdef __GLIBC__
+    return true;
+#else
+    return false;
+#endif /* __GLIBC__ */
+}
+
+quint64 AllocationCounter::allocations() {
+#ifdef __GLIBC__
+    return allocationCount.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif /* __GLIBC__ */
+}
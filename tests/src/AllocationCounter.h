@@ -0,0 +1,24 @@
+#ifndef BIRDTRAY_ALLOCATION_COUNTER_H
+#define BIRDTRAY_ALLOCATION_COUNTER_H
+
+
+#include <QtCore/QtGlobal>
+
+/**
+ * Counts the heap allocations of the whole process, including the ones of Qt.
+ */
+class AllocationCounter {
+public:
+    /**
+     * @return Whether the allocations can be counted on this platform.
+     */
+    static bool isSupported();
+    
+    /**
+     * @return The number of heap allocations since the start of the process.
+     */
+    static quint64 allocations();
+};
+
+
+#endif /* BIRDTRAY_ALLOCATION_COUNTER_H */
@@ -0,0 +1,272 @@
+#include "MorkGenerator.h"
+
+/**
+ * The ids of the columns in the column dictionary.
+ */
+enum Column {
+    MESSAGES_SCOPE = 0x80,
+    MESSAGES_KIND,
+    FOLDER_INFO_SCOPE,
+    FOLDER_INFO_KIND,
+    NUM_MESSAGES,
+    NUM_NEW_MESSAGES,
+    FOLDER_NAME,
+    FIRST_MESSAGE_COLUMN
+};
+
+/**
+ * The columns of the message rows. The first ones are text values which are stored
+ * in the value dictionary, the others are written into the cells.
+ */
+static const char* const MESSAGE_COLUMNS[] = {
+        "subject", "sender", "message-id", "date", "flags", "size"};
+static const int MESSAGE_COLUMN_COUNT = sizeof(MESSAGE_COLUMNS) / sizeof(MESSAGE_COLUMNS[0]);
+static const int TEXT_COLUMN_COUNT = 3;
+
+/**
+ * The number of message rows which are written to the file at once.
+ */
+static const int MESSAGES_PER_CHUNK = 1000;
+
+/**
+ * The buffered data is written to the file once it is larger than this.
+ */
+static const int BUFFER_SIZE = 1024 * 1024;
+
+static const char* const WORDS[] = {
+        "meeting", "invoice", "report", "holiday", "update", "release", "question", "photos",
+        "newsletter", "reminder", "order", "delivery", "project", "budget", "party", "review"};
+static const int WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+
+static QByteArray hex(quint64 value) {
+    return QByteArray::number(value, 16).toUpper();
+}
+
+MorkGenerator::MorkGenerator(const Options &options) : options(options), randomState(0) {
+}
+
+bool MorkGenerator::write(const QString &path) {
+    randomState = options.seed;
+    nextValueId = 0x80;
+    buffer.clear();
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    const int messages = qMax(0, options.messages);
+    const int groups = qMax(0, options.groups);
+    const int messagesPerGroup = messages / (groups + 1);
+    const int initialMessages = messages - messagesPerGroup * groups;
+    const int rewrites = qRound(qBound(0.0, options.rewriteRatio, 1.0) * messages);
+
+    buffer += "// <!-- <mdb:mork:z v=\"1.4\"/> -->\n";
+    writeColumns();
+
+    int writtenMessages = 0;
+    while (writtenMessages < initialMessages) {
+        const int count = qMin(MESSAGES_PER_CHUNK, initialMessages - writtenMessages);
+        writeMessages(writtenMessages + 1, count);
+        writtenMessages += count;
+        if (!flush()) {
+            file.close();
+            return false;
+        }
+    }
+    if (groups == 0) {
+        writeRewrites(rewrites, writtenMessages);
+    }
+
+    // Without groups, the initial content has the final unread count
+    writeFolderInfo(writtenMessages,
+            groups == 0 ? options.unreadMessages : static_cast<unsigned int>(
+                    randomBelow(static_cast<int>(options.unreadMessages) * 2 + 2)), true);
+
+    for (int group = 0; group < groups; group++) {
+        const QByteArray groupId = hex(0x8F00 + static_cast<quint64>(group));
+        buffer += "\n@$${" + groupId + "{@\n";
+
+        // The rewritten rows were added by the earlier groups
+        writeRewrites(rewrites / groups + (group < rewrites % groups ? 1 : 0), writtenMessages);
+        writeMessages(writtenMessages + 1, messagesPerGroup);
+        writtenMessages += messagesPerGroup;
+        writeFolderInfo(writtenMessages, group == groups - 1 ? options.unreadMessages
+                : static_cast<unsigned int>(
+                        randomBelow(static_cast<int>(options.unreadMessages) * 2 + 2)), false);
+
+        buffer += "@$$}" + groupId + "}@\n";
+        if (!flush()) {
+            file.close();
+            return false;
+        }
+    }
+
+    bool success = flush(true);
+    file.close();
+    return success;
+}
+
+QString MorkGenerator::errorString() const {
+    return file.errorString();
+}
+
+quint64 MorkGenerator::nextRandom() {
+    // SplitMix64, which gives the same numbers on every platform
+    quint64 value = (randomState += Q_UINT64_C(0x9E3779B97F4A7C15));
+    value = (value ^ (value >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+    value = (value ^ (value >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+    return value ^ (value >> 31);
+}
+
+int MorkGenerator::randomBelow(int limit) {
+    return limit > 0 ? static_cast<int>(nextRandom() % static_cast<quint64>(limit)) : 0;
+}
+
+bool MorkGenerator::randomChance(double probability) {
+    return probability > 0 && static_cast<double>(nextRandom() >> 11) / (Q_UINT64_C(1) << 53)
+                              < probability;
+}
+
+QByteArray MorkGenerator::escapedLiteral(const QByteArray &text) {
+    QByteArray literal;
+    literal.reserve(text.size() * 2);
+    for (char c : text) {
+        if (!randomChance(options.escapeDensity)) {
+            literal += c;
+            continue;
+        }
+        switch (randomBelow(5)) {
+        case 0:
+            literal += "$C3$A9";
+            break;
+        case 1:
+            literal += "\\)";
+            break;
+        case 2:
+            literal += "\\\\";
+            break;
+        case 3:
+            literal += "\\$";
+            break;
+        default:
+            // A line continuation, which is no part of the value
+            literal += "\\\n";
+            literal += c;
+            break;
+        }
+    }
+    return literal;
+}
+
+void MorkGenerator::writeColumns() {
+    buffer += "< <(a=c)> // (f=iso-8859-1)\n"
+              "  (80=ns:msg:db:row:scope:msgs:all)(81=ns:msg:db:table:kind:msgs)\n"
+              "  (82=ns:msg:db:row:scope:dbfolderinfo:all)\n"
+              "  (83=ns:msg:db:table:kind:dbfolderinfo)(84=numMsgs)(85=numNewMsgs)\n"
+              "  (86=folderName)";
+    for (int column = 0; column < options.columns; column++) {
+        buffer += "\n  (" + hex(FIRST_MESSAGE_COLUMN + column) + '=';
+        if (column < MESSAGE_COLUMN_COUNT) {
+            buffer += MESSAGE_COLUMNS[column];
+        } else {
+            buffer += "x-column-" + QByteArray::number(column - MESSAGE_COLUMN_COUNT + 1);
+        }
+        buffer += ')';
+    }
+    buffer += ">\n";
+}
+
+void MorkGenerator::writeMessages(int firstId, int count) {
+    if (count <= 0) {
+        return;
+    }
+    QVector<QVector<int>> valueIds;
+    valueIds.reserve(count);
+    buffer += '<';
+    for (int id = firstId; id < firstId + count; id++) {
+        valueIds.append(writeMessageValues(id));
+    }
+    buffer += ">\n{1:^80 {(k^81:c)(s=9)}";
+    for (int i = 0; i < count; i++) {
+        buffer += "\n  [" + hex(firstId + i);
+        writeMessageCells(firstId + i, valueIds[i]);
+        buffer += ']';
+    }
+    buffer += "}\n";
+}
+
+void MorkGenerator::writeRewrites(int count, int writtenMessages) {
+    if (count <= 0 || writtenMessages <= 0) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        const int id = randomBelow(writtenMessages) + 1;
+        buffer += '<';
+        const QVector<int> valueIds = writeMessageValues(id);
+        buffer += ">\n[-" + hex(id) + ":^80";
+        writeMessageCells(id, valueIds);
+        buffer += "]\n";
+    }
+}
+
+void MorkGenerator::writeMessageCells(int id, const QVector<int> &valueIds) {
+    for (int column = 0; column < options.columns; column++) {
+        buffer += "(^" + hex(FIRST_MESSAGE_COLUMN + column);
+        if (column < valueIds.size()) {
+            buffer += '^' + hex(static_cast<quint64>(valueIds[column]));
+        } else if (column == 3) {
+            buffer += '=' + hex(1600000000 + static_cast<quint64>(id) * 97);
+        } else if (column == 4) {
+            buffer += '=' + hex(randomChance(0.1) ? 0 : 1);
+        } else if (column == 5) {
+            buffer += '=' + hex(500 + static_cast<quint64>(randomBelow(100000)));
+        } else {
+            buffer += '=' + escapedLiteral("value " + QByteArray::number(randomBelow(1000)));
+        }
+        buffer += ')';
+    }
+}
+
+QVector<int> MorkGenerator::writeMessageValues(int id) {
+    QVector<int> valueIds;
+    const int textColumns = qMin(options.columns, TEXT_COLUMN_COUNT);
+    for (int column = 0; column < textColumns; column++) {
+        QByteArray text;
+        switch (column) {
+        case 0:
+            text = QByteArray("Message ") + QByteArray::number(id) + " about the "
+                   + WORDS[randomBelow(WORD_COUNT)] + ' ' + WORDS[randomBelow(WORD_COUNT)];
+            break;
+        case 1:
+            text = "Sender " + QByteArray::number(randomBelow(500))
+                   + " <sender@example.com>";
+            break;
+        default:
+            text = hex(nextRandom()) + "@example.com";
+            break;
+        }
+        const int valueId = nextValueId++;
+        buffer += '(' + hex(static_cast<quint64>(valueId)) + '=' + escapedLiteral(text) + ')';
+        valueIds.append(valueId);
+    }
+    return valueIds;
+}
+
+void MorkGenerator::writeFolderInfo(int totalMessages, unsigned int unreadMessages, bool inTable) {
+    const QByteArray cells = "(^84=" + hex(static_cast<quint64>(totalMessages))
+                             + ")(^85=" + hex(unreadMessages) + ')';
+    if (inTable) {
+        buffer += "{1:^82 {(k^83:c)(s=9)}\n  [1" + cells + "(^86=Inbox)]}\n";
+    } else {
+        buffer += "[1:^82" + cells + "]\n";
+    }
+}
+
+bool MorkGenerator::flush(bool force) {
+    if (buffer.isEmpty() || (!force && buffer.size() < BUFFER_SIZE)) {
+        return true;
+    }
+    bool success = file.write(buffer) == buffer.size();
+    buffer.clear();
+    return success;
+}
@@ -0,0 +1,165 @@
+#ifndef BIRDTRAY_MORK_GENERATOR_H
+#define BIRDTRAY_MORK_GENERATOR_H
+
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+/**
+ * Writes synthetic Mork 1.4 mail folder databases which look like the ones Betterbird writes.
+ * The same options always produce the same file.
+ */
+class MorkGenerator {
+public:
+    /**
+     * The shape of the generated file.
+     */
+    struct Options {
+        /**
+         * The number of message rows.
+         */
+        int messages = 1000;
+
+        /**
+         * The number of cells of each message row.
+         */
+        int columns = 6;
+
+        /**
+         * The number of transaction groups which are appended after the initial content.
+         * The messages are spread over the initial content and the groups.
+         */
+        int groups = 0;
+
+        /**
+         * The fraction of the characters of the text values which are written
+         * as $xx or \ escapes.
+         */
+        double escapeDensity = 0.0;
+
+        /**
+         * The number of cut and rewritten message rows, as a fraction of the messages.
+         * The rows are rewritten in the transaction groups after the one which added them.
+         */
+        double rewriteRatio = 0.0;
+
+        /**
+         * The final value of numNewMsgs in the folder info.
+         */
+        unsigned int unreadMessages = 0;
+
+        /**
+         * The seed of the random values.
+         */
+        quint64 seed = 1;
+    };
+
+    explicit MorkGenerator(const Options &options);
+
+    /**
+     * Write the mork file.
+     *
+     * @param path The path of the file to write.
+     * @return true on success, false otherwise.
+     */
+    bool write(const QString &path);
+
+    /**
+     * @return The error of the last failed write.
+     */
+    QString errorString() const;
+
+private:
+    /**
+     * @return The next pseudo random number.
+     */
+    quint64 nextRandom();
+
+    /**
+     * @param limit The exclusive upper bound.
+     * @return A pseudo random number between 0 and limit.
+     */
+    int randomBelow(int limit);
+
+    /**
+     * @param probability The probability of true, between 0 and 1.
+     * @return A pseudo random boolean.
+     */
+    bool randomChance(double probability);
+
+    /**
+     * @param text The value, which must not contain characters which need escaping.
+     * @return The value as a literal, with escapes according to the escape density.
+     */
+    QByteArray escapedLiteral(const QByteArray &text);
+
+    /**
+     * Append the column dictionary.
+     */
+    void writeColumns();
+
+    /**
+     * Append message rows with their values, the values are added to a value dictionary first.
+     *
+     * @param firstId The id of the first row.
+     * @param count The number of rows.
+     */
+    void writeMessages(int firstId, int count);
+
+    /**
+     * Append cut and rewritten rows of messages which were written before.
+     *
+     * @param count The number of rows to rewrite.
+     * @param writtenMessages The number of messages written so far.
+     */
+    void writeRewrites(int count, int writtenMessages);
+
+    /**
+     * Append the cells of a message row, without the row brackets.
+     *
+     * @param id The id of the row.
+     * @param valueIds The ids of the text values of the row in the value dictionary.
+     */
+    void writeMessageCells(int id, const QVector<int> &valueIds);
+
+    /**
+     * Append the text values of a message to the value dictionary.
+     *
+     * @param id The id of the message.
+     * @return The ids of the values.
+     */
+    QVector<int> writeMessageValues(int id);
+
+    /**
+     * Append the folder info row.
+     *
+     * @param totalMessages The number of messages.
+     * @param unreadMessages The number of unread messages.
+     * @param inTable Whether the row is written in its table or as a row update.
+     */
+    void writeFolderInfo(int totalMessages, unsigned int unreadMessages, bool inTable);
+
+    /**
+     * Write the buffered data to the file if enough of it accumulated.
+     *
+     * @param force Whether to write any buffered data.
+     * @return true on success, false otherwise.
+     */
+    bool flush(bool force = false);
+
+    const Options options;
+    quint64 randomState;
+
+    /**
+     * The next free id in the value dictionary.
+     */
+    int nextValueId = 0x80;
+
+    QFile file;
+    QByteArray buffer;
+};
+
+
+#endif /* BIRDTRAY_MORK_GENERATOR_H */
@@ -6,6 +6,14 @@ QString TestResources::getAbsoluteResourcePath(const QString &name) {
     return getResourceBasePath() + QDir::separator() + QDir::toNativeSeparators(name);
 }
 
+QStringList TestResources::getAbsoluteResourcePaths(const QString &nameFilter) {
+    QStringList paths;
+    for (const QString &name : QDir(getResourceBasePath()).entryList({nameFilter}, QDir::Files)) {
+        paths.append(getAbsoluteResourcePath(name));
+    }
+    return paths;
+}
+
 QString TestResources::getResourceBasePath() {
     QDir sourceFile(__FILE__);
     sourceFile.cdUp();
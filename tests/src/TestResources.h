@@ -3,6 +3,7 @@
 
 
 #include <QtCore/QString>
+#include <QtCore/QStringList>
 
 /**
  * A class for handling resources for the tests.
@@ -17,6 +18,14 @@ public:
      */
     static QString getAbsoluteResourcePath(const QString& name);
 
+    /**
+     * Get the absolute paths to all test resource files matching a name filter.
+     *
+     * @param nameFilter The wildcard filter for the file names, e.g. "*.msf".
+     * @return The absolute paths to the matching test resources.
+     */
+    static QStringList getAbsoluteResourcePaths(const QString& nameFilter);
+
 private:
     
     /**
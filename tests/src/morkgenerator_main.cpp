@@ -0,0 +1,47 @@
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <cstdio>
+#include "MorkGenerator.h"
+
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Writes a synthetic Mork mail folder database.");
+    parser.addHelpOption();
+    parser.addOptions({
+            {"messages", "The number of messages.", "count", "1000"},
+            {"columns", "The number of cells of each message row.", "count", "6"},
+            {"groups", "The number of appended transaction groups.", "count", "0"},
+            {"escape-density", "The fraction of the characters which are escaped.",
+             "fraction", "0"},
+            {"rewrite-ratio", "The number of cut and rewritten rows, "
+                              "as a fraction of the messages.", "fraction", "0"},
+            {"unread", "The final number of unread messages.", "count", "0"},
+            {"seed", "The seed of the random values.", "seed", "1"},
+    });
+    parser.addPositionalArgument("file", "The mork file to write.");
+    parser.process(app);
+
+    const QStringList files = parser.positionalArguments();
+    if (files.size() != 1) {
+        parser.showHelp(1);
+    }
+
+    MorkGenerator::Options options;
+    options.messages = parser.value("messages").toInt();
+    options.columns = parser.value("columns").toInt();
+    options.groups = parser.value("groups").toInt();
+    options.escapeDensity = parser.value("escape-density").toDouble();
+    options.rewriteRatio = parser.value("rewrite-ratio").toDouble();
+    options.unreadMessages = parser.value("unread").toUInt();
+    options.seed = parser.value("seed").toULongLong();
+
+    MorkGenerator generator(options);
+    if (!generator.write(files.first())) {
+        fprintf(stderr, "Failed to write %s: %s\n",
+                qPrintable(files.first()), qPrintable(generator.errorString()));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <logqueue.h>
+
+#include <thread>
+#include <vector>
+
+
+using namespace testing;
+
+TEST(LogQueue, rejectsRecordsWhenFull) {
+    LogQueue queue(4);
+    LogRecord record;
+    for (int i = 0; i < 4; i++) {
+        record.time = i;
+        record.text = QString::number(i);
+        ASSERT_TRUE(queue.push(record)) << "Expected the queue to take " << i + 1 << " records";
+    }
+    record.time = 4;
+    record.text = "4";
+    EXPECT_FALSE(queue.push(record)) << "Expected the full queue to reject the record";
+    EXPECT_EQ(record.text, QString("4")) << "Expected the rejected record to be untouched";
+
+    LogRecord popped;
+    ASSERT_TRUE(queue.pop(popped));
+    EXPECT_EQ(popped.time, 0);
+    EXPECT_EQ(popped.text, QString("0"));
+    EXPECT_TRUE(queue.push(record)) << "Expected the queue to take a record after one was taken";
+
+    for (int i = 1; i <= 4; i++) {
+        ASSERT_TRUE(queue.pop(popped));
+        EXPECT_EQ(popped.time, i) << "Expected the records in the order they were added";
+    }
+    EXPECT_FALSE(queue.pop(popped)) << "Expected the queue to be empty";
+}
+
+TEST(LogQueue, keepsTheOrderOfEachProducer) {
+    const int producerCount = 4;
+    const int recordsPerProducer = 20000;
+    LogQueue queue(64);
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < producerCount; producer++) {
+        producers.emplace_back([&queue, producer, recordsPerProducer]() {
+            for (int i = 0; i < recordsPerProducer; i++) {
+                LogRecord record;
+                record.time = static_cast<qint64>(producer) * recordsPerProducer + i;
+                while (!queue.push(record)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::vector<qint64> nextRecord(producerCount, 0);
+    int received = 0;
+    LogRecord record;
+    while (received < producerCount * recordsPerProducer) {
+        if (!queue.pop(record)) {
+            std::this_thread::yield();
+            continue;
+        }
+        int producer = static_cast<int>(record.time / recordsPerProducer);
+        ASSERT_GE(producer, 0);
+        ASSERT_LT(producer, producerCount);
+        ASSERT_EQ(record.time % recordsPerProducer, nextRecord[producer])
+                << "Expected the records of producer " << producer << " in order";
+        nextRecord[producer]++;
+        received++;
+    }
+    for (std::thread &producer : producers) {
+        producer.join();
+    }
+    EXPECT_FALSE(queue.pop(record)) << "Expected no records besides the added ones";
+}
+
+TEST(LogRecord, formatsArgumentsLikePrintf) {
+    QByteArray temporary("temporary");
+    LogRecord record;
+    record.format = "%s=%d %u 0x%lX %5.2f%% [%-4s] %c";
+    record.arguments.append(LogArgument(temporary.constData()));
+    record.arguments.append(LogArgument(-42));
+    record.arguments.append(LogArgument(4000000000u));
+    record.arguments.append(LogArgument(0xBEEFUL));
+    record.arguments.append(LogArgument(3.14159));
+    record.arguments.append(LogArgument("ab"));
+    record.arguments.append(LogArgument('z'));
+    temporary = "overwritten";
+    EXPECT_EQ(record.message(), QString("temporary=-42 4000000000 0xBEEF  3.14% [ab  ] z"))
+            << "Expected the copied arguments to be formatted like printf does";
+
+    record.format = "%x %X %u %o %hx %hhu %lx %d";
+    record.arguments.clear();
+    record.arguments.append(LogArgument(-1));
+    record.arguments.append(LogArgument(-2));
+    record.arguments.append(LogArgument(-3));
+    record.arguments.append(LogArgument(static_cast<short>(-1)));
+    record.arguments.append(LogArgument(-1));
+    record.arguments.append(LogArgument(-1));
+    record.arguments.append(LogArgument(-1LL));
+    record.arguments.append(LogArgument(static_cast<signed char>(-5)));
+    EXPECT_EQ(record.message(),
+            QString("ffffffff FFFFFFFE 4294967293 37777777777 ffff 255 ffffffffffffffff -5"))
+            << "Expected negative integers to be formatted with their own size like printf does";
+
+    record.format = "%d and %d";
+    record.arguments.clear();
+    record.arguments.append(LogArgument(1));
+    EXPECT_EQ(record.message(), QString("1 and <missing>"))
+            << "Expected a missing argument to be marked";
+
+    record.format = nullptr;
+    record.text = "already formatted %d";
+    EXPECT_EQ(record.message(), QString("already formatted %d"))
+            << "Expected the text of a record without a format as is";
+}
@@ -1,9 +1,106 @@
 #include <gtest/gtest.h>
+#include <morkatomtable.h>
 #include <morkparser.h>
+#include <morkscancache.h>
+#include <morkstructuralindex.h>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QTemporaryDir>
+#include "AllocationCounter.h"
 #include "TestResources.h"
+#include "MorkGenerator.h"
+#include <thread>
+#include <vector>
+
+#ifdef __GLIBC__
+#  include <malloc.h>
+#  if __GLIBC_PREREQ(2, 33)
+#    define HAVE_MALLINFO2
+#  endif
+#endif
 
 using namespace testing;
 
+/**
+ * A MailMorkParser which exposes how much data was scanned for the ends of the groups.
+ */
+class GroupScanMorkParser : public MailMorkParser {
+public:
+    qint64 getGroupEndScanLength() const {
+        return groupEndScanLength_;
+    }
+};
+
+/**
+ * A MorkParser which exposes the memory usage of its row storage.
+ */
+class RowStoreMorkParser : public MorkParser {
+public:
+    qint64 getRowStoreMemoryUsage() const {
+        return rows_.memoryUsage();
+    }
+};
+
+/**
+ * A MorkHandler which records the content it receives as lines of text.
+ */
+class RecordingMorkHandler : public MorkHandler {
+public:
+    const MorkReader* reader = nullptr;
+    QStringList events;
+
+    void onDictEntry(MorkDictType dict, int id, const MorkLiteral &value) override {
+        events.append(QString(dict == ColumnDict ? "column %1=%2" : "value %1=%2")
+                .arg(QString::number(id, 16), QString::fromUtf8(reader->decodeLiteral(value))));
+    }
+
+    void onTableBegin(int tableScope, int tableId) override {
+        events.append(QString("table %1:%2").arg(QString::number(tableScope, 16))
+                .arg(QString::number(tableId, 16)));
+    }
+
+    void onTableEnd() override {
+        events.append("table end");
+    }
+
+    bool onRowBegin(int tableScope, int tableId, int rowScope, int rowId) override {
+        events.append("row " + rowText(tableScope, tableId, rowScope, rowId));
+        return true;
+    }
+
+    void onRowCut() override {
+        events.append("cut");
+    }
+
+    void onCell(int column, const MorkLiteral &value, bool valueOid) override {
+        events.append(QString("cell %1%2%3").arg(QString::number(column, 16))
+                .arg(valueOid ? "^" : "=").arg(QString::fromUtf8(reader->decodeLiteral(value))));
+    }
+
+    void onRowEnd() override {
+        events.append("row end");
+    }
+
+    void onRowReference(int tableScope, int tableId, int rowScope, int rowId) override {
+        events.append("row reference " + rowText(tableScope, tableId, rowScope, rowId));
+    }
+
+    void onGroupBegin() override {
+        events.append("group");
+    }
+
+    void onGroupCommit() override {
+        events.append("commit");
+    }
+
+private:
+    static QString rowText(int tableScope, int tableId, int rowScope, int rowId) {
+        return QString("%1:%2 %3:%4").arg(QString::number(tableScope, 16))
+                .arg(QString::number(tableId, 16)).arg(QString::number(rowScope, 16))
+                .arg(QString::number(rowId, 16));
+    }
+};
+
 TEST(MailMorkParser, correctUnreadCount) {
     std::pair<const char*, unsigned int> cases[] = {
             std::make_pair("6_Unread_Inbox.msf", 6),
@@ -15,6 +112,7 @@ TEST(MailMorkParser, correctUnreadCount) {
             std::make_pair("1_Unread_Unified.msf", 1),
             std::make_pair("2_Unread_Unified.msf", 2),
             std::make_pair("2_Unread_Inbox_Duplicate_cells.msf", 2),
+            std::make_pair("3_Unread_Escaped_Literals.msf", 3),
     };
     for (const auto &testCase : cases) {
         MailMorkParser parser;
@@ -29,3 +127,517 @@ TEST(MailMorkParser, correctUnreadCount) {
                            "read the correct unread value from " << qPrintable(path);
     }
 }
+
+TEST(MorkUnreadScanner, sameUnreadCountAsFullParser) {
+    const QStringList paths = TestResources::getAbsoluteResourcePaths("*.msf");
+    ASSERT_FALSE(paths.isEmpty()) << "Expected to find the mork test resources";
+    for (const QString &path : paths) {
+        MailMorkParser parser;
+        MorkUnreadScanner scanner;
+        if (!parser.open(path)) {
+            ADD_FAILURE() << "Expected the MailMorkParser to be able to open " << qPrintable(path);
+            continue;
+        }
+        if (!scanner.open(path)) {
+            ADD_FAILURE() << "Expected the MorkUnreadScanner to be able to open "
+                          << qPrintable(path);
+            continue;
+        }
+        EXPECT_EQ(scanner.getNumUnreadMessages(), parser.getNumUnreadMessages())
+                        << "Expected the MorkUnreadScanner to read the same unread value "
+                           "as the MailMorkParser from " << qPrintable(path);
+    }
+}
+
+TEST(MorkParser, readsIdsAndLiteralsAcrossWhitespace) {
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QString path = directory.filePath("Ids.msf");
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write("// <!-- <mdb:mork:z v=\"1.4\"/> -->\n"
+               "<<(a=c)>(80=ns:msg:db:row:scope:msgs:all)(81=subject)(82=sender)>\n"
+               "<(90\n    =Line \\\nwrapped)(91=a\\\\)>\n"
+               "{ 1 :^80\n"
+               "  [ 2:^80 (^81^90)(^82=x)]\n"
+               "  [0x3(^81^91)]\n"
+               "  [-2 (^82=y\\)$3F)]}\n");
+    file.close();
+
+    MorkParser parser;
+    ASSERT_TRUE(parser.open(path)) << "Expected the MorkParser to be able to open "
+                                   << qPrintable(path);
+    EXPECT_EQ(parser.getValue(0x90), QString("Line wrapped"))
+                    << "Expected the MorkParser to read a dict id followed by a line break";
+    EXPECT_EQ(parser.getValue(0x91), QString("a\\"))
+                    << "Expected an escaped backslash not to escape the closing bracket";
+    const MorkRowMap* rows = parser.rows(0x80, 1, 0x80);
+    ASSERT_NE(rows, nullptr) << "Expected the MorkParser to read a table id with whitespace";
+    ASSERT_TRUE(rows->contains(2));
+    EXPECT_FALSE(rows->value(2).contains(0x81)) << "Expected the cut row to lose its cells";
+    EXPECT_EQ(parser.getValue(rows->value(2).value(0x82)), QString("y)?"));
+    ASSERT_TRUE(rows->contains(3)) << "Expected the MorkParser to read a 0x prefixed row id";
+    EXPECT_EQ(parser.getValue(rows->value(3).value(0x81)), QString("a\\"));
+}
+
+TEST(MorkReader, reportsTheContentToAHandler) {
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QString path = directory.filePath("Events.msf");
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write("// <!-- <mdb:mork:z v=\"1.4\"/> -->\n"
+               "<<(a=c)>(80=ns:msg:db:row:scope:msgs:all)(81=subject)>\n"
+               "<(90=Hello)(91=)>\n"
+               "{1:^80 {(k^81:c)} 5\n"
+               "  [2(^81^90)(^81=duplicate)]}\n"
+               "[-2(^81=x)]\n"
+               "@$${1{@[3:^80(^81=y)]@$$}1}@\n"
+               "@$${2{@[4(^81=z)]@$$}~abort~2}@\n");
+    file.close();
+
+    RecordingMorkHandler handler;
+    MorkReader reader(&handler);
+    handler.reader = &reader;
+    ASSERT_TRUE(reader.open(path)) << "Expected the MorkReader to be able to open "
+                                   << qPrintable(path);
+    const QStringList expected = {
+            "column 80=ns:msg:db:row:scope:msgs:all",
+            "column 81=subject",
+            "value 90=Hello",
+            "table 80:1",
+            "row reference 80:1 80:5",
+            "row 80:1 80:2",
+            "cell 81^90",
+            "row end",
+            "table end",
+            "row 0:0 80:2",
+            "cut",
+            "cell 81=x",
+            "row end",
+            "group",
+            "row 0:0 80:3",
+            "cell 81=y",
+            "row end",
+            "commit",
+    };
+    EXPECT_EQ(handler.events.join("\n"), expected.join("\n"))
+                    << "Expected the MorkReader to report the content in the order it is written, "
+                       "without empty values, duplicate cells and aborted groups";
+}
+
+TEST(MorkStructuralIndex, findsTheSameCharsAsAByteByByteScan) {
+    // Every byte value, followed by mork data at every alignment and a partial last block
+    QByteArray data;
+    for (int c = 0; c < 256; c++) {
+        data += static_cast<char>(c);
+    }
+    const QByteArray mork = "<(80=a\\)b$C3$A9 c@d/e)>{1:^80 [1(^81^90)]}\r\n@$${1{@ |~x}@\n";
+    for (int i = 0; i < 20; i++) {
+        data += mork.mid(i % mork.size()) + QByteArray(i, ' ');
+    }
+
+    using Implementation = MorkStructuralIndex::Implementation;
+    for (Implementation implementation : {Implementation::Scalar, Implementation::Sse2,
+                                          Implementation::Avx2, Implementation::Best}) {
+        if (!MorkStructuralIndex::isSupported(implementation)) {
+            continue;
+        }
+        MorkStructuralIndex index;
+        index.reset(data.constData(), data.size(), implementation);
+        int expectedStructural = data.size();
+        int expectedLiteral = data.size();
+        // Backwards, so each offset is looked up after the ones following it
+        for (int offset = data.size() - 1; offset >= 0; offset--) {
+            if (MorkStructuralIndex::isStructural(data[offset])) {
+                expectedStructural = offset;
+            }
+            if (MorkStructuralIndex::isLiteralSpecial(data[offset])) {
+                expectedLiteral = offset;
+            }
+            ASSERT_EQ(index.next(offset), expectedStructural)
+                            << "Unexpected structural char with implementation "
+                            << static_cast<int>(implementation) << " at offset " << offset;
+            ASSERT_EQ(index.nextInLiteral(offset), expectedLiteral)
+                            << "Unexpected literal char with implementation "
+                            << static_cast<int>(implementation) << " at offset " << offset;
+        }
+        EXPECT_EQ(index.next(data.size()), data.size());
+    }
+}
+
+static void appendToFile(const QString &path, const QByteArray &data) {
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly | QIODevice::Append));
+    ASSERT_EQ(file.write(data), data.size());
+}
+
+TEST(MorkUnreadScanner, parsesAppendedTransactions) {
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QString path = directory.filePath("Inbox.msf");
+    ASSERT_TRUE(QFile::copy(
+            TestResources::getAbsoluteResourcePath("3_Unread_Escaped_Literals.msf"), path));
+
+    MorkUnreadScanner scanner;
+    ASSERT_TRUE(scanner.update(path));
+    EXPECT_EQ(scanner.getNumUnreadMessages(), 3u);
+
+    // A committed group updates the counter, an aborted group doesn't
+    appendToFile(path, "\n@$${1{@<(94=5)>\n[1:^9F(^A2^94)]@$$}1}@\n"
+                       "@$${2{@[1:^9F(^A2=9)]@$$}~abort~2}@\n");
+    ASSERT_TRUE(scanner.update(path));
+    EXPECT_EQ(scanner.getNumUnreadMessages(), 5u);
+
+    // A group which is still being written is parsed once it is complete
+    appendToFile(path, "@$${3{@[-1:^9F(^A1=7)");
+    ASSERT_TRUE(scanner.update(path));
+    EXPECT_EQ(scanner.getNumUnreadMessages(), 5u);
+    appendToFile(path, "(^A2=7)]@$$}3}@\n");
+    ASSERT_TRUE(scanner.update(path));
+    EXPECT_EQ(scanner.getNumUnreadMessages(), 7u);
+
+    MorkUnreadScanner fullScanner;
+    ASSERT_TRUE(fullScanner.open(path));
+    EXPECT_EQ(fullScanner.getNumUnreadMessages(), 7u);
+
+    // A rewritten file is parsed from the start
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write("// <!-- <mdb:mork:z v=\"1.4\"/> -->\n"
+               "<<(a=c)>(9F=ns:msg:db:row:scope:dbfolderinfo:all)(A2=numNewMsgs)>\n"
+               "{1:^9F [1(^A2=2)]}\n");
+    file.close();
+    ASSERT_TRUE(scanner.update(path));
+    EXPECT_EQ(scanner.getNumUnreadMessages(), 2u);
+}
+
+TEST(MorkUnreadScanner, continuesFromACheckpoint) {
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QString path = directory.filePath("Inbox.msf");
+    ASSERT_TRUE(QFile::copy(
+            TestResources::getAbsoluteResourcePath("3_Unread_Escaped_Literals.msf"), path));
+
+    QByteArray checkpoint;
+    {
+        MorkUnreadScanner scanner;
+        EXPECT_TRUE(scanner.saveCheckpoint().isEmpty())
+                        << "Expected no checkpoint before the file was parsed";
+        ASSERT_TRUE(scanner.update(path));
+        checkpoint = scanner.saveCheckpoint();
+    }
+    ASSERT_FALSE(checkpoint.isEmpty());
+
+    // The scanner of the next run only parses the appended group
+    appendToFile(path, "\n@$${1{@<(94=5)>\n[1:^9F(^A2^94)]@$$}1}@\n");
+    MorkUnreadScanner scanner;
+    ASSERT_TRUE(scanner.restoreCheckpoint(path, checkpoint));
+    EXPECT_EQ(scanner.getNumUnreadMessages(), 3u)
+                    << "Expected the restored scanner to have the unread count of the checkpoint";
+    ASSERT_TRUE(scanner.update(path));
+    EXPECT_EQ(scanner.getNumUnreadMessages(), 5u);
+
+    QByteArray corrupted = checkpoint;
+    corrupted.chop(1);
+    EXPECT_FALSE(scanner.restoreCheckpoint(path, corrupted))
+                    << "Expected a truncated checkpoint to be rejected";
+    corrupted = checkpoint;
+    corrupted[3] = static_cast<char>(corrupted[3] + 1);
+    EXPECT_FALSE(scanner.restoreCheckpoint(path, corrupted))
+                    << "Expected a checkpoint of another version to be rejected";
+    EXPECT_FALSE(scanner.restoreCheckpoint(directory.filePath("Other.msf"), checkpoint))
+                    << "Expected a checkpoint of another file to be rejected";
+
+    // A rewritten file is parsed from the start
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write("// <!-- <mdb:mork:z v=\"1.4\"/> -->\n"
+               "<<(a=c)>(9F=ns:msg:db:row:scope:dbfolderinfo:all)(A2=numNewMsgs)>\n"
+               "{1:^9F [1(^A2=2)]}\n" + QByteArray(4096, ' '));
+    file.close();
+    EXPECT_FALSE(scanner.restoreCheckpoint(path, checkpoint))
+                    << "Expected the checkpoint of a rewritten file to be rejected";
+    ASSERT_TRUE(scanner.update(path));
+    EXPECT_EQ(scanner.getNumUnreadMessages(), 2u);
+}
+
+TEST(MorkScanCache, ignoresADamagedCacheFile) {
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QString path = directory.filePath("cache/mork-cache.bin");
+
+    MorkScanCache cache(path);
+    EXPECT_FALSE(cache.load()) << "Expected a missing cache file not to be loaded";
+    cache.setCheckpoint("a.msf", "first");
+    cache.setCheckpoint("b.msf", "second");
+    cache.retain(QStringList() << "a.msf");
+    EXPECT_TRUE(cache.isModified());
+    ASSERT_TRUE(cache.save());
+    EXPECT_FALSE(cache.isModified());
+
+    MorkScanCache loaded(path);
+    ASSERT_TRUE(loaded.load());
+    EXPECT_EQ(loaded.checkpoint("a.msf"), QByteArray("first"));
+    EXPECT_TRUE(loaded.checkpoint("b.msf").isEmpty())
+                    << "Expected the checkpoint of a file which is no longer watched to be removed";
+
+    // Flip a byte of the checkpoint, which the checksum must catch
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::ReadWrite));
+    QByteArray data = file.readAll();
+    const int offset = data.indexOf("first");
+    ASSERT_GE(offset, 0);
+    data[offset] = 'F';
+    ASSERT_TRUE(file.seek(0));
+    file.write(data);
+    file.close();
+    EXPECT_FALSE(loaded.load()) << "Expected a damaged cache file to be ignored";
+    EXPECT_TRUE(loaded.checkpoint("a.msf").isEmpty());
+}
+
+TEST(MorkAtomTable, internsEachNameOnceAcrossThreads) {
+    static const int THREADS = 4;
+    static const int NAMES = 200;
+    std::vector<std::vector<int>> atoms(THREADS);
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < THREADS; thread++) {
+        threads.emplace_back([thread, &atoms]() {
+            for (int i = 0; i < NAMES; i++) {
+                atoms[thread].push_back(MorkAtomTable::intern(
+                        "atom-test-column-" + QByteArray::number(i)));
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    for (int i = 0; i < NAMES; i++) {
+        const QByteArray name = "atom-test-column-" + QByteArray::number(i);
+        EXPECT_NE(atoms[0][i], 0);
+        for (int thread = 1; thread < THREADS; thread++) {
+            EXPECT_EQ(atoms[thread][i], atoms[0][i])
+                            << "Expected every thread to get the same atom for " << name.constData();
+        }
+        EXPECT_EQ(MorkAtomTable::find(name), atoms[0][i]);
+        EXPECT_EQ(MorkAtomTable::name(atoms[0][i]), name);
+    }
+    EXPECT_EQ(MorkAtomTable::find("atom-test-unknown-column"), 0);
+
+    // The parsers translate the atoms back to the column names
+    MorkParser parser;
+    const int sizeBefore = MorkAtomTable::size();
+    ASSERT_TRUE(parser.open(TestResources::getAbsoluteResourcePath("6_Unread_Inbox.msf")));
+    const int sizeAfterFirstOpen = MorkAtomTable::size();
+    ASSERT_TRUE(parser.open(TestResources::getAbsoluteResourcePath("6_Unread_Inbox.msf")));
+    EXPECT_EQ(MorkAtomTable::size(), sizeAfterFirstOpen)
+                    << "Expected the column names to be interned only once";
+    EXPECT_GE(sizeAfterFirstOpen, sizeBefore);
+    const int numNewMsgsColumn = parser.findColumn("numNewMsgs");
+    ASSERT_NE(numNewMsgsColumn, 0);
+    EXPECT_EQ(parser.getColumn(numNewMsgsColumn), QString("numNewMsgs"));
+}
+
+TEST(MorkParser, decodesEscapedLiterals) {
+    MorkParser parser;
+    QString path = TestResources::getAbsoluteResourcePath("3_Unread_Escaped_Literals.msf");
+    ASSERT_TRUE(parser.open(path)) << "Expected the MorkParser to be able to open "
+                                   << qPrintable(path);
+    EXPECT_EQ(parser.findColumn("subject"), 0x81)
+                    << "Expected the MorkParser to find a column by its name";
+    EXPECT_EQ(parser.findColumn("unknown"), 0)
+                    << "Expected the MorkParser not to find an unknown column";
+    const std::pair<int, const char*> values[] = {
+            std::make_pair(0x90, "Price $10 (net)"),
+            std::make_pair(0x91, "caf\xc3\xa9"),
+            std::make_pair(0x92, "split line"),
+            std::make_pair(0x93, "a\\b"),
+    };
+    for (const auto &value : values) {
+        EXPECT_EQ(parser.getValue(value.first), QString::fromUtf8(value.second))
+                        << "Expected the MorkParser to decode the escaped value " << value.first;
+    }
+    const MorkRowMap* rows = parser.rows(0x80, 1, 0x80);
+    ASSERT_NE(rows, nullptr) << "Expected the MorkParser to find the message table";
+    ASSERT_TRUE(rows->contains(2));
+    EXPECT_EQ(parser.getValue(rows->value(2).value(0x82)), QString("x)y"))
+                    << "Expected an escaped bracket not to end a cell literal";
+    ASSERT_TRUE(rows->contains(3));
+    EXPECT_FALSE(rows->value(3).contains(0x82))
+                    << "Expected an empty cell literal not to set a value";
+}
+
+TEST(MorkGenerator, generatedFilesHaveTheFinalUnreadCount) {
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    MorkGenerator::Options options;
+    options.messages = 3000;
+    options.columns = 9;
+    options.groups = 20;
+    options.escapeDensity = 0.05;
+    options.rewriteRatio = 0.2;
+    options.unreadMessages = 42;
+    const QString path = directory.filePath("Generated.msf");
+    MorkGenerator generator(options);
+    ASSERT_TRUE(generator.write(path)) << qPrintable(generator.errorString());
+
+    MailMorkParser parser;
+    ASSERT_TRUE(parser.open(path)) << "Expected the MailMorkParser to be able to open "
+                                   "the generated file: " << qPrintable(parser.errorMsg());
+    EXPECT_EQ(parser.getNumUnreadMessages(), options.unreadMessages)
+                    << "Expected the unread count of the last transaction group";
+    const MorkRowMap* rows = parser.rows(0x80, 1, 0x80);
+    ASSERT_NE(rows, nullptr) << "Expected the MorkParser to find the message table";
+    EXPECT_EQ(rows->size(), options.messages)
+                    << "Expected the rewritten rows not to add messages";
+    EXPECT_EQ(rows->value(1).size(), options.columns)
+                    << "Expected a cell for each column in the message rows";
+
+    MorkUnreadScanner scanner;
+    ASSERT_TRUE(scanner.update(path));
+    EXPECT_EQ(scanner.getNumUnreadMessages(), options.unreadMessages);
+
+    QFile first(path);
+    ASSERT_TRUE(first.open(QIODevice::ReadOnly));
+    const QByteArray firstData = first.readAll();
+    ASSERT_TRUE(generator.write(path));
+    QFile second(path);
+    ASSERT_TRUE(second.open(QIODevice::ReadOnly));
+    EXPECT_EQ(second.readAll(), firstData) << "Expected the same options to give the same file";
+}
+
+TEST(MorkParser, scansEachGroupOnce) {
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    MorkGenerator::Options options;
+    options.groups = 2000;
+    options.messages = options.groups * 10;
+    options.unreadMessages = 3;
+    const QString path = directory.filePath("Groups.msf");
+    ASSERT_TRUE(MorkGenerator(options).write(path));
+
+    GroupScanMorkParser parser;
+    ASSERT_TRUE(parser.open(path)) << "Expected the MailMorkParser to be able to open "
+                                   << qPrintable(path);
+    EXPECT_EQ(parser.getNumUnreadMessages(), options.unreadMessages);
+
+    // Searching every group end from the start of the group to the end of the file,
+    // like the parser used to do, scans about a thousand times the size of the file
+    RecordProperty("group end scan length", std::to_string(parser.getGroupEndScanLength()));
+    EXPECT_GT(parser.getGroupEndScanLength(), 0);
+    EXPECT_LE(parser.getGroupEndScanLength(), QFileInfo(path).size())
+                    << "Expected the end of each group to be found with a single forward scan";
+}
+
+TEST(MorkParser, rowStoreUsesLessMemoryThanNestedMaps) {
+#ifdef HAVE_MALLINFO2
+    for (const char* name : {"1_Unread_Inbox_Large.msf", "1_Unread_Inbox_Duplicate_cells.msf"}) {
+        RowStoreMorkParser parser;
+        QString path = TestResources::getAbsoluteResourcePath(name);
+        ASSERT_TRUE(parser.open(path)) << "Expected the MorkParser to be able to open "
+                                       << qPrintable(path);
+
+        // The nested maps of all tables are what the parser used to store
+        const size_t heapUsageBefore = mallinfo2().uordblks;
+        for (int tableScope : parser.getTableScopes()) {
+            ASSERT_NE(parser.getTables(tableScope), nullptr);
+        }
+        const qint64 mapsMemoryUsage = static_cast<qint64>(mallinfo2().uordblks - heapUsageBefore);
+        const qint64 rowStoreMemoryUsage = parser.getRowStoreMemoryUsage();
+
+        RecordProperty(std::string(name) + " maps", std::to_string(mapsMemoryUsage));
+        RecordProperty(std::string(name) + " row store", std::to_string(rowStoreMemoryUsage));
+        EXPECT_LT(rowStoreMemoryUsage, mapsMemoryUsage)
+                        << "Expected the row storage of " << name << " to use less memory "
+                           "than the nested maps";
+    }
+#else
+    GTEST_SKIP() << "Measuring the heap usage requires glibc";
+#endif
+}
+
+/**
+ * @param parser The parser which opens the file.
+ * @param path The path to the mork file.
+ * @return The number of heap allocations while the parser opened the file,
+ *         or -1 if it wasn't able to open it.
+ */
+static qint64 countOpenAllocations(MailMorkParser &parser, const QString &path) {
+    const quint64 allocations = AllocationCounter::allocations();
+    if (!parser.open(path)) {
+        return -1;
+    }
+    return static_cast<qint64>(AllocationCounter::allocations() - allocations);
+}
+
+TEST(MorkParser, reusedParserKeepsItsStorage) {
+    if (!AllocationCounter::isSupported()) {
+        GTEST_SKIP() << "Counting the heap allocations requires glibc";
+    }
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    MorkGenerator::Options options;
+    options.messages = 5000;
+    options.columns = 12;
+    options.escapeDensity = 0.02;
+    options.unreadMessages = 7;
+    const QString path = directory.filePath("Generated.msf");
+    ASSERT_TRUE(MorkGenerator(options).write(path));
+
+    MailMorkParser freshParser;
+    const qint64 freshAllocations = countOpenAllocations(freshParser, path);
+    ASSERT_GE(freshAllocations, 0) << "Expected the MailMorkParser to be able to open "
+                                   << qPrintable(path);
+
+    MailMorkParser reusedParser;
+    ASSERT_GE(countOpenAllocations(reusedParser, path), 0);
+    reusedParser.reset();
+    const qint64 reusedAllocations = countOpenAllocations(reusedParser, path);
+    ASSERT_GE(reusedAllocations, 0);
+    EXPECT_EQ(reusedParser.getNumUnreadMessages(), options.unreadMessages);
+
+    // Opening a file with a single row on the reused parser gives the allocations which
+    // don't depend on the number of rows, like the file mapping and the table lookups
+    MorkGenerator::Options singleRowOptions = options;
+    singleRowOptions.messages = 1;
+    singleRowOptions.unreadMessages = 1;
+    const QString singleRowPath = directory.filePath("SingleRow.msf");
+    ASSERT_TRUE(MorkGenerator(singleRowOptions).write(singleRowPath));
+    reusedParser.reset();
+    const qint64 singleRowAllocations = countOpenAllocations(reusedParser, singleRowPath);
+    ASSERT_GE(singleRowAllocations, 0);
+
+    RecordProperty("fresh parser allocations", std::to_string(freshAllocations));
+    RecordProperty("reused parser allocations", std::to_string(reusedAllocations));
+    RecordProperty("single row allocations", std::to_string(singleRowAllocations));
+    // Opening the file still allocates, but nothing is allocated for the rows
+    EXPECT_LE(reusedAllocations, singleRowAllocations)
+                    << "Expected a reused parser to keep the storage of its dicts and rows";
+    EXPECT_LT(reusedAllocations, freshAllocations);
+}
+
+TEST(MorkParser, firstCellOfAColumnWins) {
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QString path = directory.filePath("Inbox.msf");
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write("// <!-- <mdb:mork:z v=\"1.4\"/> -->\n"
+               "<<(a=c)>(80=ns:msg:db:row:scope:msgs:all)(81=subject)(123456=x-wide)>\n"
+               "{1:^80 [1(^81=first)(^123456=one)(^81=second)(^123456=two)]\n"
+               "  [2(^81=other)(^123456=three)(^123456=four)]}\n");
+    file.close();
+
+    MorkParser parser;
+    ASSERT_TRUE(parser.open(path));
+    const MorkRowMap* rows = parser.rows(0x80, 1, 0x80);
+    ASSERT_NE(rows, nullptr);
+    ASSERT_EQ(rows->size(), 2);
+    EXPECT_EQ(parser.getValue(rows->value(1).value(0x81)), QString("first"));
+    EXPECT_EQ(parser.getValue(rows->value(1).value(0x123456)), QString("one"))
+                    << "Expected the first cell of a column with a large id to be kept";
+    EXPECT_EQ(parser.getValue(rows->value(2).value(0x81)), QString("other"))
+                    << "Expected the columns of a row not to count as duplicates in the next row";
+    EXPECT_EQ(parser.getValue(rows->value(2).value(0x123456)), QString("three"));
+}
@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+#include <filechangestate.h>
+#include <morkparser.h>
+#include <morkscantask.h>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QThreadPool>
+#include "MorkGenerator.h"
+
+
+/**
+ * Write a generated mork file.
+ *
+ * @param path The path of the file.
+ * @param messages The number of messages.
+ * @param unreadMessages The number of unread messages.
+ * @return true on success, false otherwise.
+ */
+static bool writeMorkFile(const QString &path, int messages, unsigned int unreadMessages) {
+    MorkGenerator::Options options;
+    options.messages = messages;
+    options.groups = messages / 100;
+    options.unreadMessages = unreadMessages;
+    options.seed = unreadMessages;
+    return MorkGenerator(options).write(path);
+}
+
+TEST(MorkScanTask, scansSeveralFilesInParallel) {
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    static const int FILE_COUNT = 6;
+    QVector<MorkUnreadScanner*> scanners;
+    QList<MorkScanTask*> tasks;
+    for (int i = 0; i < FILE_COUNT; i++) {
+        const QString path = directory.filePath(QString("Folder%1.msf").arg(i));
+        ASSERT_TRUE(writeMorkFile(path, 500 * (i + 1), static_cast<unsigned int>(i * 3 + 1)));
+        scanners.append(new MorkUnreadScanner());
+        tasks.append(new MorkScanTask(path, scanners.last(), QByteArray()));
+    }
+    MorkUnreadScanner missingScanner;
+    tasks.append(new MorkScanTask(directory.filePath("Missing.msf"), &missingScanner, QByteArray()));
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(3);
+    MorkScanTask::runAll(pool, tasks);
+
+    for (int i = 0; i < FILE_COUNT; i++) {
+        EXPECT_TRUE(tasks[i]->mSuccess) << "Expected the scan of " << qPrintable(tasks[i]->mPath)
+                                        << " to succeed";
+        EXPECT_EQ(scanners[i]->getNumUnreadMessages(), static_cast<unsigned int>(i * 3 + 1))
+                        << "Expected the unread count of " << qPrintable(tasks[i]->mPath);
+        EXPECT_FALSE(tasks[i]->mCheckpoint.isEmpty())
+                        << "Expected a checkpoint after the scan of " << qPrintable(tasks[i]->mPath);
+    }
+    EXPECT_FALSE(tasks.last()->mSuccess) << "Expected the scan of a missing file to fail";
+    EXPECT_TRUE(tasks.last()->mCheckpoint.isEmpty());
+    qDeleteAll(tasks);
+    qDeleteAll(scanners);
+}
+
+TEST(MorkScanTask, runsASingleTaskWithoutThePool) {
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    const QString path = directory.filePath("Inbox.msf");
+    ASSERT_TRUE(writeMorkFile(path, 300, 5));
+
+    MorkUnreadScanner scanner;
+    MorkScanTask task(path, &scanner, QByteArray());
+    QThreadPool pool;
+    pool.setMaxThreadCount(1);
+    MorkScanTask::runAll(pool, QList<MorkScanTask*>() << &task);
+    EXPECT_TRUE(task.mSuccess);
+    EXPECT_EQ(scanner.getNumUnreadMessages(), 5u);
+
+    // The next scanner of the file continues from the checkpoint
+    MorkUnreadScanner nextScanner;
+    MorkScanTask nextTask(path, &nextScanner, task.mCheckpoint);
+    MorkScanTask::runAll(pool, QList<MorkScanTask*>() << &nextTask);
+    EXPECT_TRUE(nextTask.mSuccess);
+    EXPECT_EQ(nextScanner.getNumUnreadMessages(), 5u);
+}
+
+/**
+ * Replace the bytes of a file at the given position without changing its size
+ * or its modification time.
+ *
+ * @param path The path of the file.
+ * @param position The position of the replaced bytes.
+ * @param data The new bytes.
+ * @return true on success, false otherwise.
+ */
+static bool overwriteKeepingTime(const QString &path, qint64 position, const QByteArray &data) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    const QDateTime modified = file.fileTime(QFileDevice::FileModificationTime);
+    if (!file.seek(position) || file.write(data) != data.size()) {
+        return false;
+    }
+    file.flush();
+    return file.setFileTime(modified, QFileDevice::FileModificationTime);
+}
+
+TEST(MorkFileFingerprint, unchangedFileKeepsItsFingerprint) {
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    const QString path = directory.filePath("Inbox.msf");
+    ASSERT_TRUE(writeMorkFile(path, 300, 5));
+    const MorkFileFingerprint fingerprint = MorkFileFingerprint::of(path);
+    EXPECT_EQ(fingerprint.size, QFileInfo(path).size());
+    EXPECT_TRUE(MorkFileFingerprint::of(path) == fingerprint)
+                    << "Expected an unchanged file to be skipped";
+    EXPECT_TRUE(MorkFileFingerprint::of(directory.filePath("Missing.msf")) != fingerprint);
+}
+
+TEST(MorkFileFingerprint, changedTailChangesTheFingerprint) {
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    const QString path = directory.filePath("Inbox.msf");
+    ASSERT_TRUE(writeMorkFile(path, 300, 5));
+    const MorkFileFingerprint fingerprint = MorkFileFingerprint::of(path);
+
+    // An edit in the tail is detected even if the size and the modification time are the same
+    ASSERT_TRUE(overwriteKeepingTime(path, fingerprint.size - 2, "XX"));
+    const MorkFileFingerprint editedFingerprint = MorkFileFingerprint::of(path);
+    EXPECT_EQ(editedFingerprint.size, fingerprint.size);
+    EXPECT_TRUE(editedFingerprint.modified == fingerprint.modified);
+    EXPECT_TRUE(editedFingerprint != fingerprint) << "Expected a tail modified file to be rescanned";
+
+    // Appended changes are detected
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly | QIODevice::Append));
+    ASSERT_EQ(file.write("@$${1{@\n@$$}1}@\n"), 16);
+    file.close();
+    EXPECT_TRUE(MorkFileFingerprint::of(path) != editedFingerprint)
+                    << "Expected an appended file to be rescanned";
+}
+
+TEST(MorkFileFingerprint, missesSameSizeEditsBeforeTheTail) {
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    const QString path = directory.filePath("Inbox.msf");
+    ASSERT_TRUE(writeMorkFile(path, 300, 5));
+    const MorkFileFingerprint fingerprint = MorkFileFingerprint::of(path);
+    ASSERT_GT(fingerprint.size, MorkFileFingerprint::TAIL_SIZE * 2);
+
+    // The documented limitation: this edit keeps the size and the modification time
+    // and lies before the hashed tail, so the file is not rescanned
+    ASSERT_TRUE(overwriteKeepingTime(path, fingerprint.size - MorkFileFingerprint::TAIL_SIZE * 2, "XX"));
+    EXPECT_TRUE(MorkFileFingerprint::of(path) == fingerprint);
+}
+
+TEST(FileChangeState, windowGrowsDuringBursts) {
+    const qint64 base = 1000;
+    EXPECT_EQ(FileChangeState::nextWindow(base, base - 1, base), base * 2);
+    EXPECT_EQ(FileChangeState::nextWindow(base * 2, 0, base), base * 4);
+
+    FileChangeState state;
+    state.recordChange(0, base);
+    EXPECT_EQ(state.window, base);
+    state.recordChange(500, base);
+    EXPECT_EQ(state.window, base * 2);
+    state.recordChange(1500, base);
+    EXPECT_EQ(state.window, base * 4);
+    EXPECT_EQ(state.pendingSince, 0);
+    EXPECT_EQ(state.lastChange, 1500);
+}
+
+TEST(FileChangeState, windowIsCapped) {
+    const qint64 base = 1000;
+    const qint64 maxWindow = base * FileChangeState::MAX_WINDOW_FACTOR;
+    EXPECT_EQ(FileChangeState::nextWindow(maxWindow / 2, 0, base), maxWindow);
+    EXPECT_EQ(FileChangeState::nextWindow(maxWindow, 0, base), maxWindow);
+
+    FileChangeState state;
+    for (qint64 now = 0; now < 100 * base; now += base / 2) {
+        state.recordChange(now, base);
+        EXPECT_LE(state.window, maxWindow);
+    }
+    EXPECT_EQ(state.window, maxWindow);
+}
+
+TEST(FileChangeState, windowDecaysWhenQuiet) {
+    const qint64 base = 1000;
+    EXPECT_EQ(FileChangeState::nextWindow(base * 8, base * 8 * 4 + 1, base), base * 4);
+    EXPECT_EQ(FileChangeState::nextWindow(base * 2, base * 2 * 4 + 1, base), base);
+    EXPECT_EQ(FileChangeState::nextWindow(base, base * 100, base), base);
+
+    // A gap between one and four windows keeps the window
+    EXPECT_EQ(FileChangeState::nextWindow(base * 4, base * 4, base), base * 4);
+    EXPECT_EQ(FileChangeState::nextWindow(base * 4, base * 4 * 4, base), base * 4);
+}
+
+TEST(FileChangeState, deadlineIsLimitedByTheMaximumLatency) {
+    const qint64 base = 1000;
+    FileChangeState state;
+    state.recordChange(0, base);
+    EXPECT_EQ(state.deadline(base), base);
+
+    // A file which keeps changing is read after the maximum latency
+    qint64 now = 0;
+    while (now < base * FileChangeState::MAX_LATENCY_FACTOR) {
+        now += base / 2;
+        state.recordChange(now, base);
+    }
+    EXPECT_EQ(state.deadline(base), base * FileChangeState::MAX_LATENCY_FACTOR);
+}